@@ -3,8 +3,20 @@
 #include <chrono>
 #include <iomanip>
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <array>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <set>
+#include <deque>
+#include <random>
+#include <charconv>
 
 #include "Archipelago.h"
+#include "json/json.h"
 #include "apcpp-glue.h"
 #include "apcpp-solo-gen.h"
 
@@ -50,23 +62,451 @@ std::u8string room_seed_name;
 constexpr std::u8string_view gen_file_prefix = u8"AP_";
 constexpr std::u8string_view gen_file_suffix = u8"_solo.zip";
 
-u32 hasItem(u64 itemId)
+// Slot data keys interned by the game through rando_slotdata_key_handle. Handles stay valid for the lifetime of
+// the process, while the values looked up through them are cached per session since slot data never changes.
+struct SlotDataKey {
+    std::string key;
+    bool has_u32;
+    u32 u32_value;
+    bool has_string;
+    std::string string_value;
+};
+
+std::vector<SlotDataKey> slotdata_keys;
+std::unordered_map<std::string, u32> slotdata_key_handles;
+
+void resetSlotDataKeyValues()
+{
+    for (SlotDataKey& slotdata_key : slotdata_keys)
+    {
+        slotdata_key.has_u32 = false;
+        slotdata_key.has_string = false;
+        slotdata_key.string_value.clear();
+    }
+}
+
+// Read-only flat copy of slot data, built at connect from the top-level keys of every compiled path. Paths compiled
+// later add their key when they're compiled, so queries never flatten anything. Children of a container are stored
+// contiguously, and strings and object keys live in a single string arena.
+enum SlotDataNodeType : u8 {
+    SLOTDATA_NULL,
+    SLOTDATA_INT,
+    SLOTDATA_STRING,
+    SLOTDATA_ARRAY,
+    SLOTDATA_OBJECT,
+};
+
+struct SlotDataNode {
+    SlotDataNodeType type;
+    u32 key;
+    u32 first;
+    u32 count;
+    int64_t value;
+};
+
+constexpr u32 SLOTDATA_NO_NODE = 0xFFFFFFFF;
+
+constexpr SlotDataNode slotdata_null_node{ .type = SLOTDATA_NULL, .key = 0, .first = 0, .count = 0, .value = 0 };
+
+struct SlotDataTree {
+    std::vector<SlotDataNode> nodes;
+    std::string strings;
+    std::unordered_map<std::string, u32> roots;
+    u32 session = 0;
+    bool built = false;
+};
+
+SlotDataTree slotdata_tree;
+
+void resetSlotDataTree()
+{
+    slotdata_tree.nodes.clear();
+    slotdata_tree.strings.clear();
+    slotdata_tree.roots.clear();
+    slotdata_tree.session += 1;
+}
+
+u32 addSlotDataString(const char* str, size_t len)
+{
+    u32 offset = (u32) slotdata_tree.strings.size();
+    slotdata_tree.strings.append(str, len);
+    slotdata_tree.strings.push_back('\0');
+    return offset;
+}
+
+void flattenSlotData(const Json::Value& value, u32 node_index)
 {
-    u32 count = 0;
-    u32 items_size = (u32) AP_GetReceivedItemsSize(state);
-    for (u32 i = 0; i < items_size; ++i)
+    SlotDataNode node = slotdata_null_node;
+    node.key = slotdata_tree.nodes[node_index].key;
+    
+    if (value.isArray() || value.isObject())
     {
-        if (AP_GetReceivedItem(state, i) == itemId)
+        node.type = value.isArray() ? SLOTDATA_ARRAY : SLOTDATA_OBJECT;
+        node.first = (u32) slotdata_tree.nodes.size();
+        node.count = value.size();
+        slotdata_tree.nodes.resize(node.first + node.count, slotdata_null_node);
+        slotdata_tree.nodes[node_index] = node;
+        
+        u32 i = 0;
+        for (auto it = value.begin(); it != value.end(); ++it, ++i)
         {
-            count += 1;
+            if (node.type == SLOTDATA_OBJECT)
+            {
+                std::string key = it.name();
+                slotdata_tree.nodes[node.first + i].key = addSlotDataString(key.data(), key.size());
+            }
+            flattenSlotData(*it, node.first + i);
+        }
+        return;
+    }
+    
+    if (value.isString())
+    {
+        const char* begin;
+        const char* end;
+        value.getString(&begin, &end);
+        node.type = SLOTDATA_STRING;
+        node.first = addSlotDataString(begin, end - begin);
+    }
+    else if (value.isNumeric() || value.isBool())
+    {
+        node.type = SLOTDATA_INT;
+        if (value.isInt64() || value.isBool())
+        {
+            node.value = value.asInt64();
+        }
+        else if (value.isUInt64())
+        {
+            node.value = (int64_t) value.asUInt64();
+        }
+        else
+        {
+            node.value = (int64_t) value.asDouble();
+        }
+    }
+    
+    slotdata_tree.nodes[node_index] = node;
+}
+
+u32 getSlotDataRoot(const std::string& key)
+{
+    auto it = slotdata_tree.roots.find(key);
+    if (it != slotdata_tree.roots.end())
+    {
+        return it->second;
+    }
+    
+    u32 root = SLOTDATA_NO_NODE;
+    const Json::Value* value = reinterpret_cast<const Json::Value*>(AP_GetSlotDataRaw(state, key.c_str()));
+    
+    if (value != nullptr)
+    {
+        root = (u32) slotdata_tree.nodes.size();
+        slotdata_tree.nodes.push_back(slotdata_null_node);
+        flattenSlotData(*value, root);
+    }
+    
+    slotdata_tree.roots.emplace(key, root);
+    return root;
+}
+
+// A compiled slot data path such as "entrances.clock_town[3]". The node it resolves to is cached per session.
+struct SlotDataPathStep {
+    std::string key;
+    u32 index;
+    bool is_index;
+};
+
+struct SlotDataPath {
+    std::vector<SlotDataPathStep> steps;
+    u32 node;
+    u32 session;
+};
+
+std::vector<SlotDataPath> slotdata_paths;
+std::unordered_map<std::string, u32> slotdata_path_handles;
+
+constexpr u32 SLOTDATA_INVALID_PATH = 0xFFFFFFFF;
+
+bool parseSlotDataPath(const std::string& path, std::vector<SlotDataPathStep>& steps)
+{
+    size_t i = 0;
+    while (i < path.size())
+    {
+        size_t key_end = path.find_first_of(".[", i);
+        if (key_end == std::string::npos)
+        {
+            key_end = path.size();
+        }
+        
+        // Every segment, including the first, has to start with a key.
+        if (key_end == i)
+        {
+            return false;
+        }
+        
+        steps.push_back(SlotDataPathStep{ .key = path.substr(i, key_end - i), .index = 0, .is_index = false });
+        i = key_end;
+        
+        while (i < path.size() && path[i] == '[')
+        {
+            size_t index_end = path.find(']', i);
+            if (index_end == std::string::npos || index_end == i + 1)
+            {
+                return false;
+            }
+            
+            u32 index = 0;
+            for (size_t digit = i + 1; digit < index_end; ++digit)
+            {
+                if (path[digit] < '0' || path[digit] > '9')
+                {
+                    return false;
+                }
+                index = index * 10 + (path[digit] - '0');
+            }
+            
+            steps.push_back(SlotDataPathStep{ .key = "", .index = index, .is_index = true });
+            i = index_end + 1;
+        }
+        
+        if (i < path.size())
+        {
+            if (path[i] != '.' || i + 1 == path.size())
+            {
+                return false;
+            }
+            i += 1;
+        }
+    }
+    
+    return !steps.empty();
+}
+
+u32 resolveSlotDataPath(SlotDataPath& path)
+{
+    if (path.session == slotdata_tree.session)
+    {
+        return path.node;
+    }
+    
+    u32 node_index = getSlotDataRoot(path.steps[0].key);
+    
+    for (size_t step_i = 1; step_i < path.steps.size() && node_index != SLOTDATA_NO_NODE; ++step_i)
+    {
+        const SlotDataPathStep& step = path.steps[step_i];
+        const SlotDataNode& node = slotdata_tree.nodes[node_index];
+        node_index = SLOTDATA_NO_NODE;
+        
+        if (step.is_index)
+        {
+            if (node.type == SLOTDATA_ARRAY && step.index < node.count)
+            {
+                node_index = node.first + step.index;
+            }
+        }
+        else if (node.type == SLOTDATA_OBJECT)
+        {
+            for (u32 child = node.first; child < node.first + node.count; ++child)
+            {
+                if (step.key == slotdata_tree.strings.c_str() + slotdata_tree.nodes[child].key)
+                {
+                    node_index = child;
+                    break;
+                }
+            }
         }
     }
-    return count;
+    
+    path.node = node_index;
+    path.session = slotdata_tree.session;
+    return node_index;
+}
+
+// Rebuilds the tree from the newly loaded slot data, resolving every compiled path.
+void buildSlotDataTree()
+{
+    resetSlotDataTree();
+    
+    for (SlotDataPath& path : slotdata_paths)
+    {
+        resolveSlotDataPath(path);
+    }
+    
+    slotdata_tree.built = true;
+}
+
+const SlotDataNode* getSlotDataPathNode(u32 handle)
+{
+    if (handle >= slotdata_paths.size())
+    {
+        return nullptr;
+    }
+    
+    u32 node_index = resolveSlotDataPath(slotdata_paths[handle]);
+    return node_index != SLOTDATA_NO_NODE ? &slotdata_tree.nodes[node_index] : nullptr;
+}
+
+// Pair written to rdram by rando_access_slotdata_raw_u32_dict_o32.
+struct SlotDataU32Pair {
+    u32 key;
+    u32 value;
+};
+
+template <>
+constexpr bool rdram_word_layout_struct<SlotDataU32Pair> = true;
+
+// Low 32 bits of an integer slot data value, or 0 for anything else. asInt64 throws above INT64_MAX, so unsigned
+// values are read as such.
+u32 getSlotDataU32(const Json::Value& value)
+{
+    if (value.isUInt64())
+    {
+        return (u32) (value.asUInt64() & 0xFFFFFFFF);
+    }
+    
+    if (value.isInt64())
+    {
+        return (u32) (value.asInt64() & 0xFFFFFFFF);
+    }
+    
+    return 0;
+}
+
+// Parses a dict key as a base 10 u32. Returns false for keys that aren't one in full.
+bool parseSlotDataU32Key(const std::string& key, u32& value)
+{
+    const char* end = key.data() + key.size();
+    auto [ptr, ec] = std::from_chars(key.data(), end, value, 10);
+    return !key.empty() && ec == std::errc{} && ptr == end;
+}
+
+// Slot options read once at connect time so getters don't go through a JSON lookup on every call.
+struct SlotOptions {
+    int64_t skullsanity;
+    int64_t shopsanity;
+    int64_t scrubsanity;
+    int64_t cowsanity;
+    int64_t curiostity_shop_trades;
+    int64_t intro_checks;
+    int64_t starting_heart_locations;
+    int64_t damage_multiplier;
+    int64_t death_behavior;
+    int64_t death_link;
+    int64_t camc;
+    int64_t magic_is_a_trap;
+    int64_t start_with_consumables;
+    int64_t permanent_chateau_romani;
+    int64_t start_with_inverted_time;
+    int64_t receive_filled_wallets;
+    int64_t remains_allow_boss_warps;
+    int64_t moon_remains_required;
+    int64_t majora_remains_required;
+    int64_t random_seed;
+    int64_t link_tunic_color;
+};
+
+SlotOptions slot_options;
+
+void loadSlotOptions()
+{
+    resetSlotDataKeyValues();
+    buildSlotDataTree();
+    
+    slot_options.skullsanity = AP_GetSlotDataInt(state, "skullsanity");
+    slot_options.shopsanity = AP_GetSlotDataInt(state, "shopsanity");
+    slot_options.scrubsanity = AP_GetSlotDataInt(state, "scrubsanity");
+    slot_options.cowsanity = AP_GetSlotDataInt(state, "cowsanity");
+    slot_options.curiostity_shop_trades = AP_GetSlotDataInt(state, "curiostity_shop_trades");
+    slot_options.intro_checks = AP_GetSlotDataInt(state, "intro_checks");
+    slot_options.starting_heart_locations = AP_GetSlotDataInt(state, "starting_heart_locations");
+    slot_options.damage_multiplier = AP_GetSlotDataInt(state, "damage_multiplier");
+    slot_options.death_behavior = AP_GetSlotDataInt(state, "death_behavior");
+    slot_options.death_link = AP_GetSlotDataInt(state, "death_link");
+    slot_options.camc = AP_GetSlotDataInt(state, "camc");
+    slot_options.magic_is_a_trap = AP_GetSlotDataInt(state, "magic_is_a_trap");
+    slot_options.start_with_consumables = AP_GetSlotDataInt(state, "start_with_consumables");
+    slot_options.permanent_chateau_romani = AP_GetSlotDataInt(state, "permanent_chateau_romani");
+    slot_options.start_with_inverted_time = AP_GetSlotDataInt(state, "start_with_inverted_time");
+    slot_options.receive_filled_wallets = AP_GetSlotDataInt(state, "receive_filled_wallets");
+    slot_options.remains_allow_boss_warps = AP_GetSlotDataInt(state, "remains_allow_boss_warps");
+    slot_options.moon_remains_required = AP_GetSlotDataInt(state, "moon_remains_required");
+    slot_options.majora_remains_required = AP_GetSlotDataInt(state, "majora_remains_required");
+    slot_options.random_seed = AP_GetSlotDataInt(state, "random_seed");
+    slot_options.link_tunic_color = AP_GetSlotDataInt(state, "link_tunic_color");
+}
+
+// Columnar mirror of APCpp's received item list, plus per-item received counts, built incrementally.
+struct ReceivedItems {
+    std::vector<int64_t> ids;
+    std::vector<int64_t> locations;
+    std::vector<int64_t> senders;
+    std::unordered_map<int64_t, u32> counts;
+    // Bumped whenever the received item list changes.
+    u32 generation = 0;
+};
+
+ReceivedItems received_items;
+
+#define RECEIVED_ITEM_FLAG_OWN_SLOT (1 << 0)
+
+// Record written to rdram by rando_get_items_since.
+struct ReceivedItemRecord {
+    u32 item;
+    s32 location;
+    u32 sending_player;
+    u32 flags;
+};
+
+template <>
+constexpr bool rdram_word_layout_struct<ReceivedItemRecord> = true;
+
+void resetReceivedItems()
+{
+    received_items.ids.clear();
+    received_items.locations.clear();
+    received_items.senders.clear();
+    received_items.counts.clear();
+    received_items.generation += 1;
+}
+
+void syncReceivedItems()
+{
+    size_t items_size = AP_GetReceivedItemsSize(state);
+    size_t items_synced = received_items.ids.size();
+    
+    // APCpp rebuilds its list from scratch on a full resync, so start over if it shrank.
+    if (items_size < items_synced)
+    {
+        resetReceivedItems();
+        items_synced = 0;
+    }
+    
+    for (size_t i = items_synced; i < items_size; ++i)
+    {
+        int64_t item_id = AP_GetReceivedItem(state, i);
+        received_items.ids.push_back(item_id);
+        received_items.locations.push_back(AP_GetReceivedItemLocation(state, i));
+        received_items.senders.push_back(AP_GetSendingPlayer(state, i));
+        received_items.counts[item_id] += 1;
+    }
+    
+    if (items_size != items_synced)
+    {
+        received_items.generation += 1;
+    }
+}
+
+u32 hasItem(u64 itemId)
+{
+    syncReceivedItems();
+    auto it = received_items.counts.find((int64_t) itemId);
+    return it != received_items.counts.end() ? it->second : 0;
 }
 
 int64_t fixLocation(u32 arg)
 {
-    if ((arg & 0xFF0000) == 0x090000 && AP_GetSlotDataInt(state, "shopsanity") == 1)
+    if ((arg & 0xFF0000) == 0x090000 && slot_options.shopsanity == 1)
     {
         u32 shopItem = arg & 0xFFFF;
         switch (shopItem)
@@ -106,65 +546,1644 @@ int64_t fixLocation(u32 arg)
                 shopItem = SI_BOMB_2;
                 break;
 
-            // case SI_BOTTLE:
-            // case SI_SWORD_GREAT_FAIRY:
-            // case SI_SWORD_KOKIRI:
-            // case SI_SWORD_RAZOR:
-            // case SI_SWORD_GILDED:
-            //     shopItem = SI_SWORD_KOKIRI;
-            //     break;
-        }
-        return 0x090000 | shopItem;
+            // case SI_BOTTLE:
+            // case SI_SWORD_GREAT_FAIRY:
+            // case SI_SWORD_KOKIRI:
+            // case SI_SWORD_RAZOR:
+            // case SI_SWORD_GILDED:
+            //     shopItem = SI_SWORD_KOKIRI;
+            //     break;
+        }
+        return 0x090000 | shopItem;
+    }
+
+    if (arg == 0x05481E && slot_options.shopsanity != 2) {
+        return 0x054D1E;
+    }
+    return arg;
+}
+
+// Per-location info resolved from APCpp's scout results, stored as flat records indexed by a dense location index.
+// Item and player names are interned into a single NUL-separated pool and referenced by offset.
+// Records are only kept once scout results have arrived; until then they're looked up again on every use.
+struct LocationInfo {
+    u32 arg;
+    bool valid;
+    int64_t location_id;
+    int64_t item;
+    int item_type;
+    bool exists;
+    bool has_local_item;
+    u32 item_player_offset;
+    u32 item_name_offset;
+};
+
+// Resolved rando_get_item_id result for a location. Progressive items depend on what has been
+// received, so they're only reused while the received item generation is unchanged.
+struct CachedItemId {
+    u32 item_id;
+    bool valid;
+    bool progressive;
+    u32 generation;
+};
+
+// Checked state of every scouted location, one bit per location. Bits are indexed by the location's position in the
+// sorted scout list, so the same seed always gets the same layout. Each word remembers the version it last changed
+// in so trackers can fetch only what changed. The version keeps counting across sessions.
+struct CheckedBitmap {
+    std::vector<int64_t> locations;
+    std::unordered_map<int64_t, u32> indices;
+    std::vector<u32> words;
+    std::vector<u32> word_versions;
+    u32 version;
+    u32 scout_replies;
+};
+
+CheckedBitmap checked_bitmap;
+
+constexpr u32 CHECKED_BITMAP_NO_INDEX = 0xFFFFFFFF;
+
+// Delta entry written by rando_get_checked_bitmap_delta.
+struct CheckedBitmapDelta {
+    u32 word_index;
+    u32 bits;
+};
+
+template <>
+constexpr bool rdram_word_layout_struct<CheckedBitmapDelta> = true;
+
+void resetCheckedBitmap()
+{
+    checked_bitmap.locations.clear();
+    checked_bitmap.indices.clear();
+    checked_bitmap.words.clear();
+    checked_bitmap.word_versions.clear();
+    checked_bitmap.scout_replies = 0;
+    checked_bitmap.version += 1;
+}
+
+void setCheckedBit(u32 index, bool checked)
+{
+    u32 word_i = index / 32;
+    u32 bit = 1u << (index % 32);
+    u32 word = checked ? (checked_bitmap.words[word_i] | bit) : (checked_bitmap.words[word_i] & ~bit);
+    
+    if (word != checked_bitmap.words[word_i])
+    {
+        checked_bitmap.words[word_i] = word;
+        checked_bitmap.word_versions[word_i] = ++checked_bitmap.version;
+    }
+}
+
+void setLocationCheckedBit(int64_t location_id, bool checked)
+{
+    auto it = checked_bitmap.indices.find(location_id);
+    if (it != checked_bitmap.indices.end())
+    {
+        setCheckedBit(it->second, checked);
+    }
+}
+
+// Counts LocationInfo replies to the scouts sent at connect. APCpp reports them on its network thread; the game thread
+// compares the count against the one the location table was filled with to notice new results.
+// Only the reply to the connect scouts counts. The server answers scouts in order, so it's the first reply after they
+// go out, and later ones, such as for hint scouts, leave the location table and bitmap layout alone.
+// The scouted locations are kept for building the checked bitmap, along with locations the server reports as checked
+// that the bitmap hasn't picked up yet.
+struct LocationScouts {
+    std::atomic<u32> replies;
+    std::atomic<bool> expecting;
+    std::mutex mutex;
+    std::vector<int64_t> locations;
+    std::vector<int64_t> checked;
+};
+
+LocationScouts location_scouts;
+
+void onLocationInfo(std::vector<AP_NetworkItem> items)
+{
+    if (!location_scouts.expecting.exchange(false, std::memory_order_acq_rel))
+    {
+        return;
+    }
+    
+    {
+        std::lock_guard lock{ location_scouts.mutex };
+        for (const AP_NetworkItem& item : items)
+        {
+            location_scouts.locations.push_back(item.location);
+        }
+    }
+    
+    location_scouts.replies.fetch_add(1, std::memory_order_release);
+}
+
+void onLocationChecked(int64_t location_id)
+{
+    std::lock_guard lock{ location_scouts.mutex };
+    location_scouts.checked.push_back(location_id);
+}
+
+void resetLocationScouts()
+{
+    std::lock_guard lock{ location_scouts.mutex };
+    location_scouts.replies = 0;
+    location_scouts.expecting = false;
+    location_scouts.locations.clear();
+    location_scouts.checked.clear();
+}
+
+// Location arguments are 24-bit, but only a few thousand are ever used, clustered in a handful of ranges.
+// Map them to dense indices with a two-level radix table whose pages are allocated on first use.
+constexpr u32 LOCATION_PAGE_BITS = 12;
+constexpr u32 LOCATION_PAGE_SIZE = 1 << LOCATION_PAGE_BITS;
+constexpr u32 LOCATION_PAGE_COUNT = 1 << (24 - LOCATION_PAGE_BITS);
+constexpr u32 LOCATION_NO_INDEX = 0xFFFFFFFF;
+
+struct LocationIndexPage {
+    u32 indices[LOCATION_PAGE_SIZE];
+};
+
+struct LocationTable {
+    std::array<std::unique_ptr<LocationIndexPage>, LOCATION_PAGE_COUNT> pages;
+    std::vector<LocationInfo> records;
+    std::vector<CachedItemId> item_ids;
+    std::string names;
+    std::unordered_map<std::string, u32> name_offsets;
+    u32 scout_replies;
+};
+
+LocationTable location_table;
+
+void resetLocationTable()
+{
+    for (auto& page : location_table.pages)
+    {
+        page.reset();
+    }
+    location_table.records.clear();
+    location_table.item_ids.clear();
+    location_table.names.clear();
+    location_table.name_offsets.clear();
+    location_table.scout_replies = 0;
+}
+
+u32 internLocationName(const char* name)
+{
+    std::string name_str = name != nullptr ? name : "";
+    auto it = location_table.name_offsets.find(name_str);
+    if (it != location_table.name_offsets.end())
+    {
+        return it->second;
+    }
+    
+    u32 offset = (u32) location_table.names.size();
+    location_table.names.append(name_str);
+    location_table.names.push_back('\0');
+    location_table.name_offsets.emplace(std::move(name_str), offset);
+    return offset;
+}
+
+const char* getLocationName(u32 offset)
+{
+    return location_table.names.c_str() + offset;
+}
+
+u32 getLocationIndex(u32 arg)
+{
+    arg &= 0xFFFFFF;
+    std::unique_ptr<LocationIndexPage>& page = location_table.pages[arg >> LOCATION_PAGE_BITS];
+    
+    if (page == nullptr)
+    {
+        page = std::make_unique<LocationIndexPage>();
+        std::fill(std::begin(page->indices), std::end(page->indices), LOCATION_NO_INDEX);
+    }
+    
+    u32& index = page->indices[arg & (LOCATION_PAGE_SIZE - 1)];
+    if (index != LOCATION_NO_INDEX)
+    {
+        return index;
+    }
+    
+    index = (u32) location_table.records.size();
+    location_table.records.push_back(LocationInfo{
+        .arg = arg,
+        .valid = false,
+        .location_id = 0,
+        .item = 0,
+        .item_type = 0,
+        .exists = false,
+        .has_local_item = false,
+        .item_player_offset = 0,
+        .item_name_offset = 0,
+    });
+    location_table.item_ids.push_back(CachedItemId{});
+    return index;
+}
+
+// Drops every record filled before the latest scout results arrived.
+void syncLocationScouts()
+{
+    u32 replies = location_scouts.replies.load(std::memory_order_acquire);
+    if (replies == location_table.scout_replies)
+    {
+        return;
+    }
+    
+    location_table.scout_replies = replies;
+    for (LocationInfo& info : location_table.records)
+    {
+        info.valid = false;
+    }
+    std::fill(location_table.item_ids.begin(), location_table.item_ids.end(), CachedItemId{});
+}
+
+const LocationInfo& getLocationInfoAt(u32 index)
+{
+    syncLocationScouts();
+    
+    LocationInfo& info = location_table.records[index];
+    if (info.valid)
+    {
+        return info;
+    }
+    
+    int64_t location_id = 0x3469420000000 | fixLocation(info.arg);
+    info.location_id = location_id;
+    info.exists = AP_LocationExists(state, location_id);
+    info.has_local_item = AP_GetLocationHasLocalItem(state, location_id);
+    info.item = info.has_local_item ? AP_GetItemAtLocation(state, location_id) : 0;
+    info.item_type = (int) AP_GetLocationItemType(state, location_id);
+    info.item_player_offset = internLocationName(AP_GetLocationItemPlayer(state, location_id));
+    info.item_name_offset = internLocationName(AP_GetLocationItemName(state, location_id));
+    info.valid = location_table.scout_replies != 0;
+    
+    return info;
+}
+
+const LocationInfo& getLocationInfo(u32 arg)
+{
+    return getLocationInfoAt(getLocationIndex(arg));
+}
+
+u32 getItemId(u32 arg, bool& progressive)
+{
+    if (arg == 0)
+    {
+        return 0;
+    }
+    
+    const LocationInfo& info = getLocationInfo(arg);
+    
+    if (info.has_local_item)
+    {
+        int64_t item = info.item & 0xFFFFFF;
+        
+        if ((item & 0xFF0000) == 0x000000)
+        {
+            u8 gi = item & 0xFF;
+            
+            if (gi == GI_SWORD_KOKIRI || gi == GI_QUIVER_30 || gi == GI_BOMB_BAG_20 || gi == GI_WALLET_ADULT)
+            {
+                progressive = true;
+            }
+            
+            if (gi == GI_SWORD_KOKIRI)
+            {
+                return (u32) MIN(GI_SWORD_KOKIRI + hasItem(0x3469420000000 | GI_SWORD_KOKIRI), GI_SWORD_GILDED);
+            }
+            
+            else if (gi == GI_QUIVER_30)
+            {
+                return (u32) MIN(GI_QUIVER_30 + hasItem(0x3469420000000 | GI_QUIVER_30), GI_QUIVER_50);
+            }
+            
+            else if (gi == GI_BOMB_BAG_20)
+            {
+                return (u32) MIN(GI_BOMB_BAG_20 + hasItem(0x3469420000000 | GI_BOMB_BAG_20), GI_BOMB_BAG_40);
+            }
+            
+            else if (gi == GI_WALLET_ADULT)
+            {
+                return (u32) MIN(GI_WALLET_ADULT + hasItem(0x3469420000000 | GI_WALLET_ADULT), GI_WALLET_GIANT);
+            }
+            
+            return (u32) gi;
+        }
+        switch (item & 0xFF0000)
+        {
+            case 0x010000:
+                switch (item & 0xFF)
+                {
+                    case 0x7F:
+                        return (u32) GI_B2;
+                    case 0x00:
+                        return (u32) GI_46;
+                    case 0x01:
+                        return (u32) GI_47;
+                    case 0x02:
+                        return (u32) GI_48;
+                    case 0x03:
+                        return (u32) GI_49;
+                }
+                return GI_NONE;
+            case 0x020000:
+                switch (item & 0xFF)
+                {
+                    case 0x00:
+                        return (u32) GI_MAGIC_JAR_SMALL;
+                    case 0x01:
+                        return (u32) GI_71;
+                    case 0x03:
+                        return (u32) GI_73;
+                }
+                return GI_NONE;
+            case 0x040000:
+                switch (item & 0xFF)
+                {
+                    case ITEM_SONG_TIME:
+                        return (u32) GI_A6;
+                    case ITEM_SONG_HEALING:
+                        return (u32) GI_AF;
+                    case ITEM_SONG_EPONA:
+                        return (u32) GI_A5;
+                    case ITEM_SONG_SOARING:
+                        return (u32) GI_A3;
+                    case ITEM_SONG_STORMS:
+                        return (u32) GI_A2;
+                    case ITEM_SONG_SONATA:
+                        return (u32) GI_AE;
+                    case ITEM_SONG_LULLABY:
+                        return (u32) GI_AD;
+                    case ITEM_SONG_NOVA:
+                        return (u32) GI_AC;
+                    case ITEM_SONG_ELEGY:
+                        return (u32) GI_A8;
+                    case ITEM_SONG_OATH:
+                        return (u32) GI_A7;
+                }
+                return GI_NONE;
+            case 0x090000:
+                switch (item & 0xFF)
+                {
+                    case ITEM_KEY_BOSS:
+                        return (u32) (GI_MAX + (((item >> 8) & 0xF) * 4) + 1);
+                    case ITEM_KEY_SMALL:
+                        return (u32) (GI_MAX + (((item >> 8) & 0xF) * 4) + 2);
+                    case ITEM_DUNGEON_MAP:
+                        return (u32) (GI_MAX + (((item >> 8) & 0xF) * 4) + 3);
+                    case ITEM_COMPASS:
+                        return (u32) (GI_MAX + (((item >> 8) & 0xF) * 4) + 4);
+                }
+                return GI_NONE;
+        }
+    }
+    
+    switch (info.item_type)
+    {
+        case ITEM_TYPE_FILLER:
+            return (u32) GI_AP_FILLER;
+        case ITEM_TYPE_USEFUL:
+            return (u32) GI_AP_USEFUL;
+        default:
+            return (u32) GI_AP_PROG;
+    }
+}
+
+// Locations sent to the server that it hasn't acknowledged as checked yet. Mirrored to a file next to the save so
+// checks made right before a disconnect or crash are replayed on the next connection.
+// Location IDs are the same in every seed, so the file also records the seed and slot its checks belong to, and its
+// contents are only kept when connecting to that same slot.
+struct LocationOutbox {
+    std::filesystem::path path;
+    std::set<int64_t> locations;
+    std::string seed_name;
+    int player_id = -1;
+    bool dirty = false;
+};
+
+LocationOutbox location_outbox;
+
+void saveLocationOutbox()
+{
+    location_outbox.dirty = false;
+    
+    if (location_outbox.path.empty())
+    {
+        return;
+    }
+    
+    std::ofstream out(location_outbox.path, std::ofstream::out | std::ofstream::trunc);
+    out << "seed " << location_outbox.seed_name << "\n";
+    out << "slot " << location_outbox.player_id << "\n";
+    for (int64_t location_id : location_outbox.locations)
+    {
+        out << location_id << "\n";
+    }
+}
+
+void loadLocationOutbox(const std::string& savePath)
+{
+    location_outbox.path = std::filesystem::path{ savePath + ".outbox" };
+    location_outbox.locations.clear();
+    location_outbox.seed_name.clear();
+    location_outbox.player_id = -1;
+    location_outbox.dirty = false;
+    
+    std::ifstream in(location_outbox.path);
+    std::string seed_line;
+    std::string tag;
+    
+    // A file without its seed and slot can't be matched to a session, so none of its checks are trusted.
+    if (!std::getline(in, seed_line) || !seed_line.starts_with("seed ") || !(in >> tag) || tag != "slot" ||
+        !(in >> location_outbox.player_id))
+    {
+        location_outbox.player_id = -1;
+        return;
+    }
+    location_outbox.seed_name = seed_line.substr(5);
+    
+    int64_t location_id;
+    while (in >> location_id)
+    {
+        location_outbox.locations.insert(location_id);
+    }
+}
+
+// Checks queued by the game only mark the outbox dirty, so a burst of them in one frame is written out once.
+void saveDirtyLocationOutbox()
+{
+    if (location_outbox.dirty)
+    {
+        saveLocationOutbox();
+    }
+}
+
+// Ties the outbox to the slot that was just connected to, dropping checks left over from any other seed or slot.
+void bindLocationOutbox()
+{
+    AP_RoomInfo room_info{};
+    AP_GetRoomInfo(state, &room_info);
+    int player_id = AP_GetPlayerID(state);
+    
+    if (room_info.seed_name == location_outbox.seed_name && player_id == location_outbox.player_id)
+    {
+        return;
+    }
+    
+    location_outbox.locations.clear();
+    location_outbox.seed_name = room_info.seed_name;
+    location_outbox.player_id = player_id;
+    saveLocationOutbox();
+}
+
+// Drops every location the server has confirmed as checked.
+void pruneLocationOutbox()
+{
+    size_t old_size = location_outbox.locations.size();
+    std::erase_if(location_outbox.locations, [](int64_t location_id) { return AP_GetLocationIsChecked(state, location_id); });
+    
+    if (location_outbox.locations.size() != old_size)
+    {
+        saveLocationOutbox();
+    }
+}
+
+// Reconnect attempts after the connection drops mid-session, backing off exponentially between attempts.
+constexpr std::chrono::milliseconds reconnect_base_delay{ 1000 };
+constexpr std::chrono::milliseconds reconnect_max_delay{ 30000 };
+
+struct ReconnectState {
+    bool active;
+    u32 attempts;
+    std::chrono::steady_clock::time_point next_attempt;
+};
+
+ReconnectState reconnect_state;
+
+// Location checks queued by rando_send_location, sent together as a single LocationChecks packet when flushed.
+// Locations are deduplicated against everything already sent this session.
+// Sent locations count as checked locally right away. The server never rejects a check, so one it hasn't confirmed
+// within location_confirm_timeout of being sent was lost with the connection and is sent again. A check only leaves
+// the outbox once the server has confirmed it.
+constexpr std::chrono::milliseconds location_confirm_timeout{ 15000 };
+
+struct LocationCheckQueue {
+    std::set<int64_t> pending;
+    std::unordered_set<int64_t> sent;
+    std::unordered_map<int64_t, std::chrono::steady_clock::time_point> awaiting;
+    std::chrono::milliseconds flush_interval{ 0 };
+    std::chrono::steady_clock::time_point last_flush;
+};
+
+LocationCheckQueue location_checks;
+
+void resetLocationChecks()
+{
+    location_checks.pending.clear();
+    location_checks.sent.clear();
+    location_checks.awaiting.clear();
+}
+
+void queueLocationCheck(int64_t location_id)
+{
+    if (location_checks.sent.insert(location_id).second)
+    {
+        location_checks.pending.insert(location_id);
+        
+        // Persisted by the next update or flush, connected or not, so checks made while offline survive a crash or quit.
+        location_outbox.locations.insert(location_id);
+        location_outbox.dirty = true;
+        
+        setLocationCheckedBit(location_id, true);
+    }
+}
+
+bool isLocationChecked(int64_t location_id)
+{
+    return location_checks.sent.contains(location_id) || location_outbox.locations.contains(location_id) ||
+        AP_GetLocationIsChecked(state, location_id);
+}
+
+void flushLocationChecks()
+{
+    location_checks.last_flush = std::chrono::steady_clock::now();
+    saveDirtyLocationOutbox();
+    
+    // Checks made while disconnected stay queued; the outbox replay sends them once the connection is back.
+    if (location_checks.pending.empty() || !AP_IsConnected(state))
+    {
+        return;
+    }
+    
+    AP_SendItem(state, location_checks.pending);
+    
+    for (int64_t location_id : location_checks.pending)
+    {
+        location_checks.awaiting[location_id] = location_checks.last_flush;
+    }
+    location_checks.pending.clear();
+}
+
+void replayLocationOutbox()
+{
+    saveLocationOutbox();
+    pruneLocationOutbox();
+    
+    if (!location_outbox.locations.empty())
+    {
+        AP_SendItem(state, location_outbox.locations);
+    }
+    
+    // The outbox already holds every pending check.
+    auto now = std::chrono::steady_clock::now();
+    for (int64_t location_id : location_outbox.locations)
+    {
+        location_checks.sent.insert(location_id);
+        location_checks.awaiting[location_id] = now;
+    }
+    location_checks.pending.clear();
+}
+
+// Drops confirmed locations from the awaiting list and queues the ones the server hasn't confirmed in time to be sent
+// again with the next flush.
+void reconcileLocationChecks()
+{
+    auto now = std::chrono::steady_clock::now();
+    
+    std::erase_if(location_checks.awaiting, [&](const auto& entry)
+    {
+        if (AP_GetLocationIsChecked(state, entry.first))
+        {
+            return true;
+        }
+        
+        if (now - entry.second >= location_confirm_timeout)
+        {
+            location_checks.pending.insert(entry.first);
+            return true;
+        }
+        
+        return false;
+    });
+}
+
+// Lays the bitmap out over the scouted locations once their list arrives. This is the only full pass; afterwards bits
+// only change as checks are queued or confirmed by the server.
+void syncCheckedBitmap()
+{
+    u32 replies = location_scouts.replies.load(std::memory_order_acquire);
+    bool rebuild = replies != checked_bitmap.scout_replies;
+    std::vector<int64_t> checked;
+    
+    {
+        std::lock_guard lock{ location_scouts.mutex };
+        if (rebuild)
+        {
+            checked_bitmap.locations = location_scouts.locations;
+        }
+        checked.swap(location_scouts.checked);
+    }
+    
+    if (rebuild)
+    {
+        std::vector<int64_t>& locations = checked_bitmap.locations;
+        std::sort(locations.begin(), locations.end());
+        locations.erase(std::unique(locations.begin(), locations.end()), locations.end());
+        
+        checked_bitmap.scout_replies = replies;
+        checked_bitmap.indices.clear();
+        checked_bitmap.words.assign((locations.size() + 31) / 32, 0);
+        checked_bitmap.version += 1;
+        checked_bitmap.word_versions.assign(checked_bitmap.words.size(), checked_bitmap.version);
+        
+        for (u32 i = 0; i < locations.size(); ++i)
+        {
+            checked_bitmap.indices.emplace(locations[i], i);
+            if (isLocationChecked(locations[i]))
+            {
+                checked_bitmap.words[i / 32] |= 1u << (i % 32);
+            }
+        }
+        
+        // The full pass already saw everything the server reported.
+        return;
+    }
+    
+    for (int64_t location_id : checked)
+    {
+        setLocationCheckedBit(location_id, true);
+    }
+}
+
+// Per-frame upkeep: saves newly queued checks, and while connected reconciles local checked state and flushes the
+// queue once the interval is up.
+void updateLocationChecks()
+{
+    saveDirtyLocationOutbox();
+    
+    if (!AP_IsConnected(state))
+    {
+        return;
+    }
+    
+    reconcileLocationChecks();
+    syncCheckedBitmap();
+    
+    if (std::chrono::steady_clock::now() - location_checks.last_flush >= location_checks.flush_interval)
+    {
+        flushLocationChecks();
+    }
+}
+
+// Progress of a non-blocking connection started by rando_connect_begin.
+typedef enum ConnectStage {
+    CONNECT_IDLE,
+    CONNECT_CONNECTING,
+    CONNECT_LOADING_SLOT_DATA,
+    CONNECT_SCOUTING,
+    CONNECT_DONE,
+    CONNECT_FAILED,
+    CONNECT_TIMED_OUT,
+} ConnectStage;
+
+// How long CONNECT_SCOUTING waits for the scout results before giving up, on top of any overall deadline.
+constexpr std::chrono::milliseconds connect_scout_timeout{ 10000 };
+
+struct ConnectState {
+    ConnectStage stage = CONNECT_IDLE;
+    bool has_deadline;
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::steady_clock::time_point scout_deadline;
+};
+
+ConnectState connect_state;
+
+int64_t last_location_sent;
+
+s16 prices[36];
+
+void getStr(uint8_t* rdram, PTR(char) ptr, std::string& outString) {
+    size_t start = outString.size();
+    size_t len = rdram_strlen(rdram, (gpr) ptr);
+    outString.resize(start + len);
+    rdram_read_bytes(rdram, (gpr) ptr, outString.data() + start, len);
+}
+
+void getU8Str(uint8_t* rdram, PTR(char) ptr, std::u8string& outString) {
+    size_t start = outString.size();
+    size_t len = rdram_strlen(rdram, (gpr) ptr);
+    outString.resize(start + len);
+    rdram_read_bytes(rdram, (gpr) ptr, reinterpret_cast<char*>(outString.data()) + start, len);
+}
+
+void setStr(uint8_t* rdram, PTR(char) ptr, const char* inString) {
+    // Include the terminator.
+    rdram_write_bytes(rdram, (gpr) ptr, inString, strlen(inString) + 1);
+}
+
+void setU8Str(uint8_t* rdram, PTR(u8) ptr, const char8_t* inString) {
+    const char* str = reinterpret_cast<const char*>(inString);
+    rdram_write_bytes(rdram, (gpr) ptr, str, strlen(str) + 1);
+}
+
+// Writes inString into a buffer of out_len bytes, truncating it in place so it always fits with its terminator.
+// Returns the buffer size needed to hold the whole string. Nothing is written if out_len is 0.
+u32 setStrBounded(uint8_t* rdram, PTR(char) ptr, u32 out_len, const char* inString, size_t in_len) {
+    if (out_len != 0) {
+        size_t copy_len = MIN(in_len, (size_t) out_len - 1);
+        rdram_write_bytes(rdram, (gpr) ptr, inString, copy_len);
+        MEM_B(copy_len, (gpr) ptr) = 0;
+    }
+    return static_cast<u32>(in_len + 1);
+}
+
+u32 setStrBounded(uint8_t* rdram, PTR(char) ptr, u32 out_len, const char* inString) {
+    return setStrBounded(rdram, ptr, out_len, inString, strlen(inString));
+}
+
+// Slot the per-player datastorage keys belong to. Set when slot data is loaded at connect, and asked of APCpp until then.
+int datastorage_player_id = -1;
+
+int getDataStoragePlayerId()
+{
+    return datastorage_player_id != -1 ? datastorage_player_id : AP_GetPlayerID(state);
+}
+
+std::string getPlayerDataStorageKey(const std::string& key, int player_id)
+{
+    return key + "_P" + std::to_string(player_id);
+}
+
+std::string getDataStorageKey(uint8_t* rdram, PTR(char) ptr, bool per_player)
+{
+    std::string key = "";
+    getStr(rdram, ptr, key);
+    
+    if (per_player)
+    {
+        key = getPlayerDataStorageKey(key, getDataStoragePlayerId());
+    }
+    
+    return key;
+}
+
+bool parseDataStorageJson(const std::string& raw, Json::Value& json)
+{
+    static std::unique_ptr<Json::CharReader> reader{ Json::CharReaderBuilder{}.newCharReader() };
+    return reader->parse(raw.data(), raw.data() + raw.size(), &json, nullptr);
+}
+
+// Datastorage keys registered through rando_datastorage_key_handle, kept with their _P suffix already applied. The
+// suffix is only rebuilt when the slot changes.
+struct DataStorageKey {
+    std::string key;
+    bool per_player;
+    int player_id;
+    std::string full_key;
+};
+
+std::vector<DataStorageKey> datastorage_keys;
+std::map<std::pair<std::string, bool>, u32> datastorage_key_handles;
+
+u32 registerDataStorageKey(std::string key, bool per_player)
+{
+    auto it = datastorage_key_handles.find({ key, per_player });
+    if (it != datastorage_key_handles.end())
+    {
+        return it->second;
+    }
+    
+    u32 handle = (u32) datastorage_keys.size();
+    int player_id = getDataStoragePlayerId();
+    std::string full_key = per_player ? getPlayerDataStorageKey(key, player_id) : key;
+    datastorage_key_handles.emplace(std::make_pair(key, per_player), handle);
+    datastorage_keys.push_back(DataStorageKey{
+        .key = std::move(key),
+        .per_player = per_player,
+        .player_id = player_id,
+        .full_key = std::move(full_key),
+    });
+    
+    return handle;
+}
+
+// Returns the full key for a handle, or nullptr if the handle is invalid.
+const std::string* getDataStorageKeyByHandle(u32 handle)
+{
+    if (handle >= datastorage_keys.size())
+    {
+        return nullptr;
+    }
+    
+    DataStorageKey& key = datastorage_keys[handle];
+    int player_id = getDataStoragePlayerId();
+    if (key.per_player && key.player_id != player_id)
+    {
+        key.full_key = getPlayerDataStorageKey(key.key, player_id);
+        key.player_id = player_id;
+    }
+    
+    return &key.full_key;
+}
+
+// Reads a datastorage value as a u32. Returns false, leaving value as 0, if it isn't a number.
+bool parseDataStorageU32(const std::string& raw, u32& value)
+{
+    Json::Value json;
+    value = 0;
+    
+    if (!parseDataStorageJson(raw, json) || !json.isNumeric())
+    {
+        return false;
+    }
+    
+    value = json.isIntegral() ? (u32) json.asLargestInt() : (u32) (int64_t) json.asDouble();
+    return true;
+}
+
+// Datastorage values arrive as JSON. Strings are unquoted, anything else is kept as its JSON text.
+std::string parseDataStorageString(const std::string& raw)
+{
+    Json::Value json;
+    
+    if (parseDataStorageJson(raw, json) && json.isString())
+    {
+        return json.asString();
+    }
+    
+    return raw;
+}
+
+// Type of a value written by rando_get_datastorage_multi_sync. Only numbers have their value filled in.
+typedef enum DataStorageValueType {
+    DATASTORAGE_VALUE_NUMBER,
+    DATASTORAGE_VALUE_NULL,
+    DATASTORAGE_VALUE_NOT_NUMBER,
+    DATASTORAGE_VALUE_ERROR,
+} DataStorageValueType;
+
+DataStorageValueType classifyDataStorageValue(const std::string& raw, u32& value)
+{
+    Json::Value json;
+    value = 0;
+    
+    if (!parseDataStorageJson(raw, json))
+    {
+        return DATASTORAGE_VALUE_NOT_NUMBER;
+    }
+    
+    if (json.isNull())
+    {
+        return DATASTORAGE_VALUE_NULL;
+    }
+    
+    if (!json.isNumeric())
+    {
+        return DATASTORAGE_VALUE_NOT_NUMBER;
+    }
+    
+    parseDataStorageU32(raw, value);
+    return DATASTORAGE_VALUE_NUMBER;
+}
+
+// Datastorage Gets started by rando_datastorage_get_begin. APCpp fills requests in from its network thread, so each
+// one stays allocated until the game polls its result, or until it's reclaimed after going unpolled for too long.
+constexpr u32 DATASTORAGE_MAX_GETS = 64;
+constexpr u32 DATASTORAGE_INVALID_REQUEST = 0xFFFFFFFF;
+constexpr std::chrono::seconds datastorage_get_expiry{ 30 };
+
+typedef enum DataStoragePollResult {
+    DATASTORAGE_PENDING,
+    DATASTORAGE_DONE,
+    DATASTORAGE_ERROR,
+} DataStoragePollResult;
+
+struct DataStorageGet {
+    AP_GetServerDataRequest request;
+    std::string value;
+};
+
+// A request ID handed to the game. Several can share one Get.
+struct DataStorageGetSlot {
+    std::shared_ptr<DataStorageGet> get;
+    std::chrono::steady_clock::time_point started;
+};
+
+struct DataStorageGets {
+    std::unordered_map<u32, DataStorageGetSlot> requests;
+    u32 next_id;
+};
+
+DataStorageGets datastorage_gets;
+
+// APCpp finishes requests from its network thread, so their status is loaded atomically, and a request's value is
+// only touched once its status has left Pending.
+AP_RequestStatus loadRequestStatus(AP_RequestStatus& status)
+{
+    return std::atomic_ref<AP_RequestStatus>(status).load(std::memory_order_acquire);
+}
+
+// Finishes a request we complete ourselves. Its value has to be written before this.
+void storeRequestStatus(AP_RequestStatus& status, AP_RequestStatus value)
+{
+    std::atomic_ref<AP_RequestStatus>(status).store(value, std::memory_order_release);
+}
+
+// Gets that were given up on while still pending. APCpp may yet write to them, so they're only freed once they finish.
+std::vector<std::shared_ptr<DataStorageGet>> datastorage_abandoned_gets;
+
+std::shared_ptr<DataStorageGet> makeDataStorageGet(std::string key)
+{
+    auto get = std::make_shared<DataStorageGet>();
+    get->request.status = AP_RequestStatus::Pending;
+    get->request.key = std::move(key);
+    get->request.value = &get->value;
+    get->request.type = AP_DataType::Raw;
+    return get;
+}
+
+// Drops a reference to a Get, parking it on the abandoned list if it was the last one and APCpp could still write to it.
+void abandonDataStorageGet(std::shared_ptr<DataStorageGet> get)
+{
+    if (get.use_count() == 1 && loadRequestStatus(get->request.status) == AP_RequestStatus::Pending)
+    {
+        datastorage_abandoned_gets.push_back(std::move(get));
+    }
+}
+
+void pruneAbandonedDataStorageGets()
+{
+    std::erase_if(datastorage_abandoned_gets,
+        [](const auto& get) { return loadRequestStatus(get->request.status) != AP_RequestStatus::Pending; });
+}
+
+// The Gets sent to APCpp, at most one per key at a time. APCpp tracks pending Gets by key, so a second one for a key
+// it's still waiting on would never finish; everything reading a key shares its Get instead. A Get sent before a write
+// to its key went out is stale, so later readers share a fresh one that's sent once the stale one finishes.
+struct DataStorageFetch {
+    std::shared_ptr<DataStorageGet> sent;
+    std::shared_ptr<DataStorageGet> next;
+    bool stale;
+};
+
+std::unordered_map<std::string, DataStorageFetch> datastorage_fetches;
+
+void advanceDataStorageFetch(DataStorageFetch& fetch)
+{
+    if (fetch.sent != nullptr && loadRequestStatus(fetch.sent->request.status) != AP_RequestStatus::Pending)
+    {
+        fetch.sent = nullptr;
+    }
+    
+    if (fetch.sent == nullptr && fetch.next != nullptr)
+    {
+        fetch.sent = std::move(fetch.next);
+        fetch.stale = false;
+        AP_GetServerData(state, &fetch.sent->request);
+    }
+}
+
+// Sends the Gets queued behind finished ones.
+void updateDataStorageFetches()
+{
+    for (auto it = datastorage_fetches.begin(); it != datastorage_fetches.end();)
+    {
+        advanceDataStorageFetch(it->second);
+        
+        if (it->second.sent == nullptr)
+        {
+            it = datastorage_fetches.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+// Returns a Get that finishes with the key's value as of now, sharing one already on its way where possible.
+std::shared_ptr<DataStorageGet> fetchDataStorageKey(const std::string& key)
+{
+    DataStorageFetch& fetch = datastorage_fetches[key];
+    advanceDataStorageFetch(fetch);
+    
+    if (fetch.next != nullptr)
+    {
+        return fetch.next;
+    }
+    
+    if (fetch.sent != nullptr && !fetch.stale)
+    {
+        return fetch.sent;
+    }
+    
+    auto get = makeDataStorageGet(key);
+    
+    if (fetch.sent != nullptr)
+    {
+        fetch.next = get;
+    }
+    else
+    {
+        fetch.sent = get;
+        fetch.stale = false;
+        AP_GetServerData(state, &get->request);
+    }
+    
+    return get;
+}
+
+// Called as a write to key goes out, after which the Get in flight for it can't be shared any more.
+void staleDataStorageFetch(const std::string& key)
+{
+    auto it = datastorage_fetches.find(key);
+    if (it != datastorage_fetches.end() && it->second.sent != nullptr)
+    {
+        it->second.stale = true;
+    }
+}
+
+// Forgets every Get in flight, for when the connection they were sent over is gone. Queued ones were never sent, so
+// they fail straight away.
+void resetDataStorageFetches()
+{
+    for (auto& [key, fetch] : datastorage_fetches)
+    {
+        if (fetch.sent != nullptr)
+        {
+            abandonDataStorageGet(std::move(fetch.sent));
+        }
+        
+        if (fetch.next != nullptr)
+        {
+            storeRequestStatus(fetch.next->request.status, AP_RequestStatus::Error);
+        }
+    }
+    
+    datastorage_fetches.clear();
+}
+
+// Releases Gets the game has stopped polling: those older than datastorage_get_expiry, and with pending_only, any
+// still pending, which is what's left of the ones sent over a connection that has since dropped.
+void reclaimDataStorageGets(bool pending_only)
+{
+    pruneAbandonedDataStorageGets();
+    
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = datastorage_gets.requests.begin(); it != datastorage_gets.requests.end();)
+    {
+        DataStorageGetSlot& slot = it->second;
+        bool expired = now - slot.started >= datastorage_get_expiry;
+        
+        if (expired || (pending_only && loadRequestStatus(slot.get->request.status) == AP_RequestStatus::Pending))
+        {
+            abandonDataStorageGet(std::move(slot.get));
+            it = datastorage_gets.requests.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+// Drops every Get along with the session it belonged to.
+void resetDataStorageGets()
+{
+    resetDataStorageFetches();
+    
+    for (auto& [id, slot] : datastorage_gets.requests)
+    {
+        abandonDataStorageGet(std::move(slot.get));
+    }
+    
+    datastorage_gets.requests.clear();
+    pruneAbandonedDataStorageGets();
+}
+
+// Makes room for another request ID. Returns false if the table is full.
+bool reserveDataStorageGet()
+{
+    if (datastorage_gets.requests.size() >= DATASTORAGE_MAX_GETS)
+    {
+        reclaimDataStorageGets(false);
+    }
+    
+    return datastorage_gets.requests.size() < DATASTORAGE_MAX_GETS;
+}
+
+// Hands out a request ID for get. Only call after reserveDataStorageGet has made room.
+u32 allocateDataStorageGet(std::shared_ptr<DataStorageGet> get)
+{
+    u32 id = datastorage_gets.next_id;
+    datastorage_gets.next_id = (id + 1) % DATASTORAGE_INVALID_REQUEST;
+    
+    datastorage_gets.requests.emplace(id, DataStorageGetSlot{ .get = std::move(get), .started = std::chrono::steady_clock::now() });
+    return id;
+}
+
+// Checks on a Get. Once it has finished, its value is copied into value and the request ID is released.
+DataStoragePollResult pollDataStorageGet(u32 id, std::string& value)
+{
+    updateDataStorageFetches();
+    
+    auto it = datastorage_gets.requests.find(id);
+    if (it == datastorage_gets.requests.end())
+    {
+        return DATASTORAGE_ERROR;
+    }
+    
+    AP_RequestStatus status = loadRequestStatus(it->second.get->request.status);
+    if (status == AP_RequestStatus::Pending)
+    {
+        return DATASTORAGE_PENDING;
+    }
+    
+    value = it->second.get->value;
+    datastorage_gets.requests.erase(it);
+    return status == AP_RequestStatus::Done ? DATASTORAGE_DONE : DATASTORAGE_ERROR;
+}
+
+// Local copy of watched datastorage keys, kept current by the SetReply the server sends whenever one of them changes.
+// Each key is seeded with a Get when it's first watched. Replies arrive on APCpp's network thread.
+// replies holds the requests waiting on the SetReply for an atomic operation made with want_reply, by the tag sent
+// with the operation.
+struct DataStorageMirror {
+    std::mutex mutex;
+    std::unordered_set<std::string> watched;
+    std::unordered_map<std::string, std::string> values;
+    std::unordered_map<std::string, std::shared_ptr<DataStorageGet>> seeds;
+    std::unordered_map<std::string, std::shared_ptr<DataStorageGet>> replies;
+};
+
+DataStorageMirror datastorage_mirror;
+
+// Fails every request still waiting on a SetReply. Called with datastorage_mirror.mutex held.
+void failDataStorageReplies()
+{
+    for (auto& [tag, get] : datastorage_mirror.replies)
+    {
+        storeRequestStatus(get->request.status, AP_RequestStatus::Error);
+    }
+    datastorage_mirror.replies.clear();
+}
+
+// Seeds may still be written to by APCpp, so they're abandoned rather than freed. The requests waiting on a SetReply
+// belong to the Get table, and fail here since their reply will never be matched.
+void resetDataStorageMirror()
+{
+    std::lock_guard lock{ datastorage_mirror.mutex };
+    datastorage_mirror.watched.clear();
+    datastorage_mirror.values.clear();
+    
+    for (auto& [key, seed] : datastorage_mirror.seeds)
+    {
+        abandonDataStorageGet(std::move(seed));
+    }
+    datastorage_mirror.seeds.clear();
+    
+    failDataStorageReplies();
+}
+
+void seedDataStorageMirror(const std::string& key)
+{
+    datastorage_mirror.seeds[key] = fetchDataStorageKey(key);
+}
+
+void watchDataStorageKey(std::string key)
+{
+    std::lock_guard lock{ datastorage_mirror.mutex };
+    if (!datastorage_mirror.watched.insert(key).second)
+    {
+        return;
+    }
+    
+    AP_SetNotify(state, key, AP_DataType::Raw);
+    seedDataStorageMirror(key);
+}
+
+// The server drops SetNotify subscriptions with the connection, so they're sent again after reconnecting, along with
+// fresh seeds. Seeds from before the drop are abandoned, keeping the value of any that finished until the new one lands.
+// SetReplies owed on the old connection are never coming.
+void rewatchDataStorageKeys()
+{
+    std::lock_guard lock{ datastorage_mirror.mutex };
+    std::map<std::string, AP_DataType> keys;
+    
+    failDataStorageReplies();
+    
+    for (const std::string& key : datastorage_mirror.watched)
+    {
+        keys.emplace(key, AP_DataType::Raw);
+        
+        auto seed_it = datastorage_mirror.seeds.find(key);
+        if (seed_it != datastorage_mirror.seeds.end())
+        {
+            if (loadRequestStatus(seed_it->second->request.status) == AP_RequestStatus::Done)
+            {
+                datastorage_mirror.values[key] = seed_it->second->value;
+            }
+            abandonDataStorageGet(std::move(seed_it->second));
+        }
+        
+        seedDataStorageMirror(key);
+    }
+    
+    if (!keys.empty())
+    {
+        AP_SetNotify(state, keys);
+    }
+}
+
+void onDataStorageSetReply(AP_SetReply reply)
+{
+    std::lock_guard lock{ datastorage_mirror.mutex };
+    const std::string& value = *reinterpret_cast<std::string*>(reply.value);
+    
+    // Other clients' Sets on a watched key come back too. Only a reply carrying one of our tags finishes a request.
+    auto reply_it = reply.tag.empty() ? datastorage_mirror.replies.end() : datastorage_mirror.replies.find(reply.tag);
+    if (reply_it != datastorage_mirror.replies.end())
+    {
+        DataStorageGet* get = reply_it->second.get();
+        get->value = value;
+        storeRequestStatus(get->request.status, AP_RequestStatus::Done);
+        datastorage_mirror.replies.erase(reply_it);
+    }
+    
+    if (!datastorage_mirror.watched.contains(reply.key))
+    {
+        return;
+    }
+    
+    datastorage_mirror.values[reply.key] = value;
+    
+    // A seed that already finished is older than this update. One that's still pending will be at least as new.
+    auto seed_it = datastorage_mirror.seeds.find(reply.key);
+    if (seed_it != datastorage_mirror.seeds.end() && loadRequestStatus(seed_it->second->request.status) != AP_RequestStatus::Pending)
+    {
+        datastorage_mirror.seeds.erase(seed_it);
+    }
+}
+
+// Looks a key up in the mirror. Returns false if it isn't watched or its value hasn't arrived yet.
+bool readDataStorageMirror(const std::string& key, std::string& raw)
+{
+    updateDataStorageFetches();
+    std::lock_guard lock{ datastorage_mirror.mutex };
+    
+    auto seed_it = datastorage_mirror.seeds.find(key);
+    AP_RequestStatus seed_status = seed_it != datastorage_mirror.seeds.end()
+        ? loadRequestStatus(seed_it->second->request.status) : AP_RequestStatus::Pending;
+    
+    if (seed_status != AP_RequestStatus::Pending)
+    {
+        if (seed_status == AP_RequestStatus::Done)
+        {
+            datastorage_mirror.values[key] = seed_it->second->value;
+        }
+        datastorage_mirror.seeds.erase(seed_it);
+    }
+    
+    auto value_it = datastorage_mirror.values.find(key);
+    if (value_it == datastorage_mirror.values.end())
+    {
+        return false;
+    }
+    
+    raw = value_it->second;
+    return true;
+}
+
+// A seed still in flight when we write to its key was sent before the write, so it's abandoned rather than left to
+// overwrite the newer value when it lands. Called with datastorage_mirror.mutex held.
+void dropDataStorageSeed(const std::string& key)
+{
+    auto seed_it = datastorage_mirror.seeds.find(key);
+    if (seed_it != datastorage_mirror.seeds.end())
+    {
+        abandonDataStorageGet(std::move(seed_it->second));
+        datastorage_mirror.seeds.erase(seed_it);
+    }
+}
+
+// Our own writes to a watched key go straight into the mirror so reads that follow see them.
+void writeDataStorageMirror(const std::string& key, const std::string& raw)
+{
+    std::lock_guard lock{ datastorage_mirror.mutex };
+    if (!datastorage_mirror.watched.contains(key))
+    {
+        return;
+    }
+    
+    dropDataStorageSeed(key);
+    datastorage_mirror.values[key] = raw;
+}
+
+// The result of an atomic operation isn't known until the server applies it, so reads of the key go to the server
+// until the SetReply for it arrives.
+void invalidateDataStorageMirror(const std::string& key)
+{
+    std::lock_guard lock{ datastorage_mirror.mutex };
+    dropDataStorageSeed(key);
+    datastorage_mirror.values.erase(key);
+}
+
+// Values written by the *_async setters, held until the next flush so a key written many times in one flush window
+// only goes to the server once, with its last value.
+struct DataStorageWrite {
+    bool is_string;
+    u32 u32_value;
+    std::string string_value;
+};
+
+struct DataStorageWriteBuffer {
+    std::map<std::string, DataStorageWrite> dirty;
+    std::chrono::milliseconds flush_interval{ 0 };
+    std::chrono::steady_clock::time_point last_flush;
+};
+
+DataStorageWriteBuffer datastorage_writes;
+
+void bufferDataStorageU32(const std::string& key, u32 value)
+{
+    writeDataStorageMirror(key, std::to_string(value));
+    
+    DataStorageWrite& write = datastorage_writes.dirty[key];
+    write.is_string = false;
+    write.u32_value = value;
+}
+
+void bufferDataStorageString(const std::string& key, std::string value)
+{
+    writeDataStorageMirror(key, value);
+    
+    DataStorageWrite& write = datastorage_writes.dirty[key];
+    write.is_string = true;
+    write.string_value = std::move(value);
+}
+
+// A blocking write supersedes anything still buffered for the same key.
+void dropBufferedDataStorageWrite(const std::string& key)
+{
+    datastorage_writes.dirty.erase(key);
+}
+
+void sendDataStorageWrite(const std::string& key, DataStorageWrite& write)
+{
+    std::string value = write.is_string ? std::move(write.string_value) : std::to_string(write.u32_value);
+    staleDataStorageFetch(key);
+    
+    try
+    {
+        AP_SetDataStorageAsync(state, key.c_str(), (char*) value.c_str());
+    }
+    
+    catch (std::exception& e)
+    {
+        fprintf(stderr, "error setting datastorage\n");
+        fprintf(stderr, "%s\n", e.what());
+    }
+}
+
+void flushDataStorageWrites()
+{
+    datastorage_writes.last_flush = std::chrono::steady_clock::now();
+    
+    if (datastorage_writes.dirty.empty() || !AP_IsConnected(state))
+    {
+        return;
+    }
+    
+    for (auto& [key, write] : datastorage_writes.dirty)
+    {
+        sendDataStorageWrite(key, write);
+    }
+    
+    datastorage_writes.dirty.clear();
+}
+
+// Sends a buffered write for key straight away so a blocking read that follows sees it.
+void flushDataStorageWrite(const std::string& key)
+{
+    auto it = datastorage_writes.dirty.find(key);
+    if (it == datastorage_writes.dirty.end() || !AP_IsConnected(state))
+    {
+        return;
+    }
+    
+    sendDataStorageWrite(it->first, it->second);
+    datastorage_writes.dirty.erase(it);
+}
+
+void updateDataStorageWrites()
+{
+    updateDataStorageFetches();
+    
+    if (std::chrono::steady_clock::now() - datastorage_writes.last_flush >= datastorage_writes.flush_interval)
+    {
+        flushDataStorageWrites();
+    }
+}
+
+u32 beginDataStorageGet(const std::string& key)
+{
+    // A write still buffered for the key has to go out first or the Get would overtake it.
+    flushDataStorageWrite(key);
+    
+    if (!reserveDataStorageGet())
+    {
+        return DATASTORAGE_INVALID_REQUEST;
+    }
+    
+    return allocateDataStorageGet(fetchDataStorageKey(key));
+}
+
+// Archipelago's atomic Set operations, applied by the server so concurrent writers don't race.
+typedef enum DataStorageOp {
+    DATASTORAGE_OP_ADD,
+    DATASTORAGE_OP_MUL,
+    DATASTORAGE_OP_MAX,
+    DATASTORAGE_OP_MIN,
+    DATASTORAGE_OP_AND,
+    DATASTORAGE_OP_OR,
+    DATASTORAGE_OP_XOR,
+    DATASTORAGE_OP_DEFAULT,
+    DATASTORAGE_OP_REPLACE,
+    DATASTORAGE_OP_COUNT,
+} DataStorageOp;
+
+constexpr std::array<const char*, DATASTORAGE_OP_COUNT> datastorage_op_names = {
+    "add", "mul", "max", "min", "and", "or", "xor", "default", "replace",
+};
+
+// Set requests stay allocated until APCpp has sent them.
+struct DataStorageSet {
+    AP_SetServerDataRequest request;
+    std::string operand;
+    std::string default_value;
+};
+
+std::vector<std::unique_ptr<DataStorageSet>> datastorage_sets;
+
+// Tags are unique to this process so a SetReply can be told apart from ones for other clients' Sets, which the server
+// also sends to everyone watching the key.
+std::string makeDataStorageReplyTag()
+{
+    static const u64 nonce = []()
+    {
+        std::random_device device;
+        return ((u64) device() << 32) | device();
+    }();
+    static u64 next_tag = 0;
+    
+    return "apcpp-glue-" + std::to_string(nonce) + "-" + std::to_string(next_tag++);
+}
+
+// Reserves a request ID that completes with the key's value from the SetReply carrying tag.
+u32 beginDataStorageReply(const std::string& key, const std::string& tag)
+{
+    if (!reserveDataStorageGet())
+    {
+        return DATASTORAGE_INVALID_REQUEST;
+    }
+    
+    auto get = makeDataStorageGet(key);
+    {
+        std::lock_guard lock{ datastorage_mirror.mutex };
+        datastorage_mirror.replies[tag] = get;
     }
+    
+    return allocateDataStorageGet(std::move(get));
+}
 
-    if (arg == 0x05481E && AP_GetSlotDataInt(state, "shopsanity") != 2) {
-        return 0x054D1E;
+// Applies op to key on the server. With want_reply, returns a request ID that rando_datastorage_get_poll completes
+// with the resulting value, otherwise DATASTORAGE_INVALID_REQUEST.
+u32 applyDataStorageOp(std::string key, DataStorageOp op, s32 operand, bool want_reply)
+{
+    // Anything still buffered for the key has to land before the operation.
+    flushDataStorageWrite(key);
+    invalidateDataStorageMirror(key);
+    staleDataStorageFetch(key);
+    
+    std::erase_if(datastorage_sets, [](const auto& set) { return loadRequestStatus(set->request.status) != AP_RequestStatus::Pending; });
+    
+    auto set = std::make_unique<DataStorageSet>();
+    set->operand = std::to_string(operand);
+    set->default_value = op == DATASTORAGE_OP_DEFAULT ? set->operand : "0";
+    set->request.status = AP_RequestStatus::Pending;
+    set->request.key = key;
+    set->request.operations.push_back(AP_DataStorageOperation{ datastorage_op_names[op], &set->operand });
+    set->request.default_value = &set->default_value;
+    set->request.type = AP_DataType::Raw;
+    set->request.want_reply = false;
+    
+    u32 id = DATASTORAGE_INVALID_REQUEST;
+    if (want_reply)
+    {
+        set->request.tag = makeDataStorageReplyTag();
+        id = beginDataStorageReply(key, set->request.tag);
+        set->request.want_reply = id != DATASTORAGE_INVALID_REQUEST;
     }
-    return arg;
+    
+    AP_SetServerData(state, &set->request);
+    datastorage_sets.push_back(std::move(set));
+    
+    return id;
 }
 
-int64_t last_location_sent;
+#define DATASTORAGE_KEY_FLAG_PER_PLAYER (1 << 0)
 
-s16 prices[36];
+// Key record read from rdram by rando_get_datastorage_multi_sync.
+struct DataStorageKeyRequest {
+    PTR(char) key;
+    u32 flags;
+};
 
-void getStr(uint8_t* rdram, PTR(char) ptr, std::string& outString) {
-    char c = MEM_B(0, (gpr) ptr);
-    u32 i = 0;
-    while (c != 0) {
-        outString += c;
-        i += 1;
-        c = MEM_B(i, (gpr) ptr);
+template <>
+constexpr bool rdram_word_layout_struct<DataStorageKeyRequest> = true;
+
+// Result record written to rdram by rando_get_datastorage_multi_sync.
+struct DataStorageValue {
+    u32 value;
+    u32 type;
+};
+
+template <>
+constexpr bool rdram_word_layout_struct<DataStorageValue> = true;
+
+// How long rando_get_datastorage_multi_sync waits on the server before reporting the keys it's missing as errors.
+constexpr std::chrono::milliseconds datastorage_multi_sync_timeout{ 5000 };
+
+void setDataStorageSync(const std::string& key, const char* value)
+{
+    dropBufferedDataStorageWrite(key);
+    writeDataStorageMirror(key, value);
+    staleDataStorageFetch(key);
+
+    try
+    {
+        AP_SetDataStorageSync(state, key.c_str(), (char*) value);
     }
-}
 
-void getU8Str(uint8_t* rdram, PTR(char) ptr, std::u8string& outString) {
-    char8_t c = MEM_B(0, (gpr) ptr);
-    u32 i = 0;
-    while (c != 0) {
-        outString += c;
-        i += 1;
-        c = MEM_B(i, (gpr) ptr);
+    catch (std::exception& e)
+    {
+        fprintf(stderr, "error setting datastorage\n");
+        fprintf(stderr, "%s\n", e.what());
     }
 }
 
-void setStr(uint8_t* rdram, PTR(char) ptr, const char* inString) {
-    char c = -1;
-    u32 i = 0;
-    while (c != 0) {
-        c = inString[i];
-        MEM_B(i, (gpr) ptr) = c;
-        i += 1;
+// Blocking datastorage reads used by the *_sync exports. Watched keys are served from the mirror instead.
+u32 getDataStorageU32Sync(const std::string& key)
+{
+    flushDataStorageWrite(key);
+    
+    std::string raw;
+    if (readDataStorageMirror(key, raw))
+    {
+        u32 value;
+        parseDataStorageU32(raw, value);
+        return value;
+    }
+    
+    char* value_char_ptr = AP_GetDataStorageSync(state, key.c_str());
+    
+    u32 value = 0;
+    
+    if (strncmp(value_char_ptr, "null", 4) != 0)
+    {
+        value = std::stoi(value_char_ptr);
     }
+    
+    return value;
 }
 
-void setU8Str(uint8_t* rdram, PTR(u8) ptr, const char8_t* inString) {
-    char8_t c = -1;
-    u32 i = 0;
-    while (c != 0) {
-        c = inString[i];
-        MEM_B(i, (gpr) ptr) = c;
-        i += 1;
+std::string getDataStorageStringSync(const std::string& key)
+{
+    flushDataStorageWrite(key);
+    
+    std::string raw;
+    if (readDataStorageMirror(key, raw))
+    {
+        return parseDataStorageString(raw);
     }
+    
+    return AP_GetDataStorageSync(state, key.c_str());
+}
+
+void resetSessionCaches()
+{
+    resetLocationScouts();
+    resetCheckedBitmap();
+    resetReceivedItems();
+    resetLocationTable();
+    resetLocationChecks();
+    resetDataStorageGets();
+    resetDataStorageMirror();
+    datastorage_writes.dirty.clear();
+    datastorage_player_id = -1;
+    reconnect_state = ReconnectState{};
 }
 
 template <typename TP>
@@ -198,23 +2217,57 @@ std::string format_file_time(std::filesystem::file_time_type time) {
     return sstream.str();
 }
 
+// Connection details saved in apconnect.txt next to the save file at save_dir_ptr, or the defaults if there isn't one.
+struct SavedAPConnect {
+    std::string address = "archipelago.gg:38281";
+    std::string player_name = "Player1";
+    std::string password = "";
+};
+
+SavedAPConnect readSavedAPConnect(uint8_t* rdram, PTR(char) save_dir_ptr)
+{
+    std::u8string save_dir;
+    getU8Str(rdram, save_dir_ptr, save_dir);
+    std::filesystem::path save_file_path{ save_dir };
+    
+    std::ifstream apconnect(save_file_path.parent_path().string() + "/apconnect.txt");
+    
+    SavedAPConnect saved;
+    
+    if (apconnect.good())
+    {
+        saved.address = "";
+        saved.player_name = "";
+        
+        glueGetLine(apconnect, saved.address);
+        glueGetLine(apconnect, saved.player_name);
+        glueGetLine(apconnect, saved.password);
+    }
+    
+    return saved;
+}
+
 extern "C"
 {
     DLLEXPORT u32 recomp_api_version = 1;
 
-    bool rando_init_common() {
+    void rando_start_common() {
         AP_SetDeathLinkSupported(state, true);
+        AP_RegisterSetReplyCallback(state, onDataStorageSetReply);
+        AP_SetLocationInfoCallback(state, onLocationInfo);
+        AP_SetLocationCheckedCallback(state, onLocationChecked);
         
         AP_Start(state);
-        
-        while (!AP_IsConnected(state))
-        {
-            if (AP_GetConnectionStatus(state) == AP_ConnectionStatus::ConnectionRefused || AP_GetConnectionStatus(state) == AP_ConnectionStatus::NotFound)
-            {
-                AP_Stop(state);
-                return false;
-            }
-        }
+    }
+    
+    bool rando_connection_failed() {
+        AP_ConnectionStatus status = AP_GetConnectionStatus(state);
+        return status == AP_ConnectionStatus::ConnectionRefused || status == AP_ConnectionStatus::NotFound;
+    }
+    
+    void rando_load_slot_data() {
+        loadSlotOptions();
+        datastorage_player_id = AP_GetPlayerID(state);
         
         const char* prices_str = AP_GetSlotDataString(state, "shop_prices");
         
@@ -227,10 +2280,12 @@ extern "C"
             prices[price_i] = price;
             price_i += 1;
         }
-        
+    }
+    
+    void rando_send_scouts() {
         AP_QueueLocationScoutsAll(state);
         
-        if (AP_GetSlotDataInt(state, "skullsanity") == 2)
+        if (slot_options.skullsanity == 2)
         {
             for (int i = 0x00; i <= 0x1E; ++i)
             {
@@ -249,13 +2304,13 @@ extern "C"
             }
         }
         
-        for (int64_t i = AP_GetSlotDataInt(state, "starting_heart_locations"); i < 8; ++i)
+        for (int64_t i = slot_options.starting_heart_locations; i < 8; ++i)
         {
             int64_t location_id = 0x34694200D0000 | i;
             AP_RemoveQueuedLocationScout(state, location_id);
         }
 
-        if (AP_GetSlotDataInt(state, "cowsanity") == 0)
+        if (slot_options.cowsanity == 0)
         {
             for (int i = 0x10; i <= 0x17; ++i)
             {
@@ -264,7 +2319,7 @@ extern "C"
             }
         }
         
-        if (AP_GetSlotDataInt(state, "scrubsanity") == 0)
+        if (slot_options.scrubsanity == 0)
         {
             AP_RemoveQueuedLocationScout(state, 0x3469420090100 | GI_MAGIC_BEANS);
             AP_RemoveQueuedLocationScout(state, 0x3469420090100 | GI_BOMB_BAG_40);
@@ -272,12 +2327,12 @@ extern "C"
             AP_RemoveQueuedLocationScout(state, 0x3469420090100 | GI_POTION_BLUE);
         }
         
-        if (AP_GetSlotDataInt(state, "shopsanity") != 2)
+        if (slot_options.shopsanity != 2)
         {
             AP_RemoveQueuedLocationScout(state, 0x346942005481E);
             AP_RemoveQueuedLocationScout(state, 0x3469420024234);
             
-            if (AP_GetSlotDataInt(state, "shopsanity") == 1)
+            if (slot_options.shopsanity == 1)
             {
                 for (int i = SI_FAIRY_2; i <= SI_POTION_RED_3; ++i)
                 {
@@ -312,7 +2367,7 @@ extern "C"
             }
         }
         
-        if (AP_GetSlotDataInt(state, "curiostity_shop_trades") == 0)
+        if (slot_options.curiostity_shop_trades == 0)
         {
             AP_RemoveQueuedLocationScout(state, 0x346942007C402);
             AP_RemoveQueuedLocationScout(state, 0x346942007C404);
@@ -320,16 +2375,45 @@ extern "C"
             AP_RemoveQueuedLocationScout(state, 0x346942007C407);
         }
         
-        if (AP_GetSlotDataInt(state, "intro_checks") == 0)
+        if (slot_options.intro_checks == 0)
         {
             AP_RemoveQueuedLocationScout(state, 0x3469420061A00);
         }
         
+        // The results arrive later through onLocationInfo. Location info is looked up live until they do.
+        location_scouts.expecting.store(true, std::memory_order_release);
         AP_SendQueuedLocationScouts(state, 0);
+        
+        bindLocationOutbox();
+        replayLocationOutbox();
+    }
+
+    bool rando_init_common() {
+        rando_start_common();
+        
+        while (!AP_IsConnected(state))
+        {
+            if (rando_connection_failed())
+            {
+                AP_Stop(state);
+                return false;
+            }
+            
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        
+        rando_load_slot_data();
+        rando_send_scouts();
 
         return true;
     }
     
+    void rando_set_room_seed_name() {
+        AP_RoomInfo roomInfo{};
+        AP_GetRoomInfo(state, &roomInfo);
+        room_seed_name = std::u8string{ reinterpret_cast<const char8_t*>(roomInfo.seed_name.data()), roomInfo.seed_name.size() };
+    }
+    
     DLLEXPORT void rando_get_saved_apconnect(uint8_t* rdram, recomp_context* ctx)
     {
         PTR(char) save_dir_ptr = _arg<0, PTR(char)>(rdram, ctx);
@@ -337,30 +2421,32 @@ extern "C"
         PTR(char) player_name_ptr = _arg<2, PTR(char)>(rdram, ctx);
         PTR(char) password_ptr = _arg<3, PTR(char)>(rdram, ctx);
         
-        std::u8string save_dir;
-        getU8Str(rdram, save_dir_ptr, save_dir);
-        std::filesystem::path save_file_path{ save_dir };
-        std::filesystem::path parent_path = save_file_path.parent_path();
+        SavedAPConnect saved = readSavedAPConnect(rdram, save_dir_ptr);
         
-        std::ifstream apconnect(save_file_path.parent_path().string() + "/apconnect.txt");
+        setStr(rdram, address_ptr, saved.address.c_str());
+        setStr(rdram, player_name_ptr, saved.player_name.c_str());
+        setStr(rdram, password_ptr, saved.password.c_str());
+    }
+    
+    // Same as rando_get_saved_apconnect, but writes each string truncated to the size of its buffer. Returns 1 if all
+    // three fit, or 0 if any was cut short.
+    DLLEXPORT void rando_get_saved_apconnect_bounded(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) save_dir_ptr = _arg<0, PTR(char)>(rdram, ctx);
+        PTR(char) address_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        u32 address_len = _arg<2, u32>(rdram, ctx);
+        PTR(char) player_name_ptr = _arg<3, PTR(char)>(rdram, ctx);
+        u32 player_name_len = _arg<4, u32>(rdram, ctx);
+        PTR(char) password_ptr = _arg<5, PTR(char)>(rdram, ctx);
+        u32 password_len = _arg<6, u32>(rdram, ctx);
         
-        std::string address = "archipelago.gg:38281";
-        std::string player_name = "Player1";
-        std::string password = "";
+        SavedAPConnect saved = readSavedAPConnect(rdram, save_dir_ptr);
         
-        if (apconnect.good())
-        {
-            address = "";
-            player_name = "";
-            
-            glueGetLine(apconnect, address);
-            glueGetLine(apconnect, player_name);
-            glueGetLine(apconnect, password);
-        }
+        bool fits = setStrBounded(rdram, address_ptr, address_len, saved.address.c_str(), saved.address.size()) <= address_len;
+        fits &= setStrBounded(rdram, player_name_ptr, player_name_len, saved.player_name.c_str(), saved.player_name.size()) <= player_name_len;
+        fits &= setStrBounded(rdram, password_ptr, password_len, saved.password.c_str(), saved.password.size()) <= password_len;
         
-        setStr(rdram, address_ptr, address.c_str());
-        setStr(rdram, player_name_ptr, player_name.c_str());
-        setStr(rdram, password_ptr, password.c_str());
+        _return<u32>(ctx, fits ? 1 : 0);
     }
     
     DLLEXPORT void rando_set_saved_apconnect(uint8_t* rdram, recomp_context* ctx)
@@ -408,18 +2494,157 @@ extern "C"
         getStr(rdram, password_ptr, password);
         
         state = AP_New(savePath.c_str());
+        resetSessionCaches();
+        loadLocationOutbox(savePath);
         AP_Init(state, address.c_str(), "Majora's Mask Recompiled", playerName.c_str(), password.c_str());
 
         bool success = rando_init_common();
         if (success) {
-            AP_RoomInfo roomInfo{};
-            AP_GetRoomInfo(state, &roomInfo);
-            room_seed_name = std::u8string{ reinterpret_cast<const char8_t*>(roomInfo.seed_name.data()), roomInfo.seed_name.size() };
+            rando_set_room_seed_name();
         }
+        connect_state.stage = success ? CONNECT_DONE : CONNECT_FAILED;
 
         _return<u32>(ctx, success);
     }
     
+    // Starts connecting to a server without blocking. Takes the same arguments as rando_init plus a timeout in
+    // milliseconds (0 for none); progress is then reported by rando_connect_poll.
+    DLLEXPORT void rando_connect_begin(uint8_t* rdram, recomp_context* ctx)
+    {
+        std::string savePath;
+        std::string address;
+        std::string playerName;
+        std::string password;
+        
+        PTR(char) save_path_ptr = _arg<0, PTR(char)>(rdram, ctx);
+        PTR(char) address_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        PTR(char) player_name_ptr = _arg<2, PTR(char)>(rdram, ctx);
+        PTR(char) password_ptr = _arg<3, PTR(char)>(rdram, ctx);
+        u32 timeout_ms = _arg<4, u32>(rdram, ctx);
+        
+        getStr(rdram, save_path_ptr, savePath);
+        getStr(rdram, address_ptr, address);
+        getStr(rdram, player_name_ptr, playerName);
+        getStr(rdram, password_ptr, password);
+        
+        state = AP_New(savePath.c_str());
+        resetSessionCaches();
+        loadLocationOutbox(savePath);
+        AP_Init(state, address.c_str(), "Majora's Mask Recompiled", playerName.c_str(), password.c_str());
+        
+        rando_start_common();
+        
+        connect_state.stage = CONNECT_CONNECTING;
+        connect_state.has_deadline = timeout_ms != 0;
+        connect_state.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    }
+    
+    // Advances the connection started by rando_connect_begin by at most one stage and returns the current ConnectStage.
+    DLLEXPORT void rando_connect_poll(uint8_t* rdram, recomp_context* ctx)
+    {
+        switch (connect_state.stage)
+        {
+            case CONNECT_CONNECTING:
+                if (AP_IsConnected(state))
+                {
+                    connect_state.stage = CONNECT_LOADING_SLOT_DATA;
+                }
+                else if (rando_connection_failed())
+                {
+                    AP_Stop(state);
+                    connect_state.stage = CONNECT_FAILED;
+                }
+                else if (connect_state.has_deadline && std::chrono::steady_clock::now() >= connect_state.deadline)
+                {
+                    AP_Stop(state);
+                    connect_state.stage = CONNECT_TIMED_OUT;
+                }
+                break;
+            case CONNECT_LOADING_SLOT_DATA:
+                rando_load_slot_data();
+                rando_send_scouts();
+                connect_state.scout_deadline = std::chrono::steady_clock::now() + connect_scout_timeout;
+                if (connect_state.has_deadline)
+                {
+                    connect_state.scout_deadline = MIN(connect_state.scout_deadline, connect_state.deadline);
+                }
+                connect_state.stage = CONNECT_SCOUTING;
+                break;
+            case CONNECT_SCOUTING:
+                // Location info isn't settled until the scout results are in, so the game waits for them.
+                if (location_scouts.replies.load(std::memory_order_acquire) != 0)
+                {
+                    rando_set_room_seed_name();
+                    connect_state.stage = CONNECT_DONE;
+                }
+                else if (std::chrono::steady_clock::now() >= connect_state.scout_deadline)
+                {
+                    AP_Stop(state);
+                    connect_state.stage = CONNECT_TIMED_OUT;
+                }
+                break;
+            default:
+                break;
+        }
+        
+        _return(ctx, (u32) connect_state.stage);
+    }
+    
+    // Called once per frame after connecting. Flushes queued location checks every flush interval and drops
+    // acknowledged checks from the outbox. If the connection has dropped, retries it with exponential backoff and
+    // replays the outbox once it's back. Returns whether the connection is currently up.
+    DLLEXPORT void rando_connection_update(uint8_t* rdram, recomp_context* ctx)
+    {
+        if (connect_state.stage != CONNECT_DONE)
+        {
+            _return<u32>(ctx, false);
+            return;
+        }
+        
+        if (AP_IsConnected(state))
+        {
+            if (reconnect_state.active)
+            {
+                reconnect_state = ReconnectState{};
+                replayLocationOutbox();
+                resetDataStorageFetches();
+                reclaimDataStorageGets(true);
+                rewatchDataStorageKeys();
+            }
+            else
+            {
+                pruneLocationOutbox();
+                updateLocationChecks();
+                updateDataStorageWrites();
+            }
+            
+            _return<u32>(ctx, true);
+            return;
+        }
+        
+        saveDirtyLocationOutbox();
+        
+        auto now = std::chrono::steady_clock::now();
+        
+        if (!reconnect_state.active)
+        {
+            reconnect_state.active = true;
+            reconnect_state.attempts = 0;
+            reconnect_state.next_attempt = now + reconnect_base_delay;
+        }
+        else if (now >= reconnect_state.next_attempt)
+        {
+            AP_Stop(state);
+            AP_Start(state);
+            
+            reconnect_state.attempts += 1;
+            auto delay = reconnect_base_delay * (1 << MIN(reconnect_state.attempts, (u32) 5));
+            reconnect_state.next_attempt = now + MIN(delay, reconnect_max_delay);
+        }
+        
+        _return<u32>(ctx, false);
+    }
+    
     DLLEXPORT void rando_init_solo(uint8_t* rdram, recomp_context* ctx)
     {
         std::string savePath;
@@ -436,6 +2661,8 @@ extern "C"
         }
         
         state = AP_New(savePath.c_str());
+        resetSessionCaches();
+        loadLocationOutbox(savePath);
         const std::u8string& seed = solo_state.seeds[selected_seed].seed_name;
         std::filesystem::path gen_file = solo_state.seed_folder / (std::u8string{ gen_file_prefix } + seed + std::u8string{ gen_file_suffix });
         AP_InitSolo(state, reinterpret_cast<const char*>(gen_file.u8string().c_str()), reinterpret_cast<const char*>(seed.c_str()));
@@ -445,6 +2672,7 @@ extern "C"
         {
             room_seed_name = seed;
         }
+        connect_state.stage = success ? CONNECT_DONE : CONNECT_FAILED;
         
         _return<u32>(ctx, success);
     }
@@ -509,22 +2737,7 @@ extern "C"
         }
         
         const std::u8string& solo_seed_name = solo_state.seeds[seed_index].seed_name;
-        u32 seed_name_size = static_cast<u32>(solo_seed_name.size() + 1);
-        
-        if (seed_name_out_len == 0)
-        {
-            // Write nothing if the output length is 0.
-        }
-        
-        else if (solo_seed_name.size() + 1 >= seed_name_out_len)
-        {
-            setU8Str(rdram, seed_name_out, solo_seed_name.substr(0, seed_name_out_len - 1).c_str());
-        }
-        
-        else
-        {
-            setU8Str(rdram, seed_name_out, solo_seed_name.c_str());
-        }
+        u32 seed_name_size = setStrBounded(rdram, seed_name_out, seed_name_out_len, reinterpret_cast<const char*>(solo_seed_name.data()), solo_seed_name.size());
         
         _return<u32>(ctx, seed_name_size);
     }
@@ -542,22 +2755,7 @@ extern "C"
         }
         
         const std::string& seed_date = solo_state.seeds[seed_index].date_string;
-        u32 seed_date_size = static_cast<u32>(seed_date.size() + 1);
-        
-        if (seed_date_out_len == 0)
-        {
-            // Write nothing if the output length is 0.
-        }
-        
-        else if (seed_date.size() + 1 >= seed_date_out_len)
-        {
-            setStr(rdram, seed_date_out, seed_date.substr(0, seed_date_out_len - 1).c_str());
-        }
-        
-        else
-        {
-            setStr(rdram, seed_date_out, seed_date.c_str());
-        }
+        u32 seed_date_size = setStrBounded(rdram, seed_date_out, seed_date_out_len, seed_date.data(), seed_date.size());
         
         _return<u32>(ctx, seed_date_size);
     }
@@ -567,22 +2765,7 @@ extern "C"
         PTR(char) seed_name_out = _arg<0, PTR(char)>(rdram, ctx);
         u32 seed_name_out_len = _arg<1, u32>(rdram, ctx);
         
-        u32 seed_name_size = static_cast<u32>(room_seed_name.size() + 1);
-        
-        if (seed_name_out_len == 0)
-        {
-            // Write nothing if the output length is 0.
-        }
-        
-        else if (room_seed_name.size() + 1 >= seed_name_out_len)
-        {
-            setU8Str(rdram, seed_name_out, room_seed_name.substr(0, seed_name_out_len - 1).c_str());
-        }
-        
-        else
-        {
-            setU8Str(rdram, seed_name_out, room_seed_name.c_str());
-        }
+        u32 seed_name_size = setStrBounded(rdram, seed_name_out, seed_name_out_len, reinterpret_cast<const char*>(room_seed_name.data()), room_seed_name.size());
         
         _return<u32>(ctx, seed_name_size);
     }
@@ -594,32 +2777,32 @@ extern "C"
     
     DLLEXPORT void rando_skulltulas_enabled(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, AP_GetSlotDataInt(state, "skullsanity") != 2);
+        _return(ctx, slot_options.skullsanity != 2);
     }
     
     DLLEXPORT void rando_shopsanity_enabled(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, AP_GetSlotDataInt(state, "shopsanity") != 0);
+        _return(ctx, slot_options.shopsanity != 0);
     }
     
     DLLEXPORT void rando_advanced_shops_enabled(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, AP_GetSlotDataInt(state, "shopsanity") == 2);
+        _return(ctx, slot_options.shopsanity == 2);
     }
 
     DLLEXPORT void rando_scrubs_enabled(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, AP_GetSlotDataInt(state, "scrubsanity") == 1);
+        _return(ctx, slot_options.scrubsanity == 1);
     }
 
     DLLEXPORT void rando_cows_enabled(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, AP_GetSlotDataInt(state, "cowsanity") == 1);
+        _return(ctx, slot_options.cowsanity == 1);
     }
     
     DLLEXPORT void rando_damage_multiplier(uint8_t* rdram, recomp_context* ctx)
     {
-        switch (AP_GetSlotDataInt(state, "damage_multiplier"))
+        switch (slot_options.damage_multiplier)
         {
             case 0:
                 _return(ctx, (u32) 0);
@@ -642,7 +2825,7 @@ extern "C"
     
     DLLEXPORT void rando_death_behavior(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, (u32) AP_GetSlotDataInt(state, "death_behavior"));
+        _return(ctx, (u32) slot_options.death_behavior);
     }
 
     DLLEXPORT void rando_get_death_link_pending(uint8_t* rdram, recomp_context* ctx)
@@ -657,7 +2840,7 @@ extern "C"
     
     DLLEXPORT void rando_get_death_link_enabled(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, AP_GetSlotDataInt(state, "death_link") == 1);
+        _return(ctx, slot_options.death_link == 1);
     }
     
     DLLEXPORT void rando_send_death_link(uint8_t* rdram, recomp_context* ctx)
@@ -667,67 +2850,67 @@ extern "C"
     
     DLLEXPORT void rando_get_camc_enabled(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, AP_GetSlotDataInt(state, "camc") == 1);
+        _return(ctx, slot_options.camc == 1);
     }
        
     DLLEXPORT void rando_is_magic_trap(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, AP_GetSlotDataInt(state, "magic_is_a_trap") == 1);
+        _return(ctx, slot_options.magic_is_a_trap == 1);
     }
 
     DLLEXPORT void rando_get_start_with_consumables_enabled(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, AP_GetSlotDataInt(state, "start_with_consumables") == 1);
+        _return(ctx, slot_options.start_with_consumables == 1);
     }
     
     DLLEXPORT void rando_get_permanent_chateau_romani_enabled(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, AP_GetSlotDataInt(state, "permanent_chateau_romani") == 1);
+        _return(ctx, slot_options.permanent_chateau_romani == 1);
     }
     
     DLLEXPORT void rando_get_start_with_inverted_time_enabled(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, AP_GetSlotDataInt(state, "start_with_inverted_time") == 1);
+        _return(ctx, slot_options.start_with_inverted_time == 1);
     }
     
     DLLEXPORT void rando_get_receive_filled_wallets_enabled(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, AP_GetSlotDataInt(state, "receive_filled_wallets") == 1);
+        _return(ctx, slot_options.receive_filled_wallets == 1);
     }
     
     DLLEXPORT void rando_get_remains_allow_boss_warps_enabled(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, (int) AP_GetSlotDataInt(state, "remains_allow_boss_warps"));
+        _return(ctx, (int) slot_options.remains_allow_boss_warps);
     }
     
     DLLEXPORT void rando_get_starting_heart_locations(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, (int) AP_GetSlotDataInt(state, "starting_heart_locations"));
+        _return(ctx, (int) slot_options.starting_heart_locations);
     }
     
     DLLEXPORT void rando_get_moon_remains_required(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, (int) AP_GetSlotDataInt(state, "moon_remains_required"));
+        _return(ctx, (int) slot_options.moon_remains_required);
     }
     
     DLLEXPORT void rando_get_majora_remains_required(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, (int) AP_GetSlotDataInt(state, "majora_remains_required"));
+        _return(ctx, (int) slot_options.majora_remains_required);
     }
     
     DLLEXPORT void rando_get_random_seed(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, (u32) AP_GetSlotDataInt(state, "random_seed"));
+        _return(ctx, (u32) slot_options.random_seed);
     }
     
     DLLEXPORT void rando_get_curiostity_shop_trades(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, (int) AP_GetSlotDataInt(state, "curiostity_shop_trades"));
+        _return(ctx, (int) slot_options.curiostity_shop_trades);
     }
     
     DLLEXPORT void rando_get_tunic_color(uint8_t* rdram, recomp_context* ctx)
     {
-        _return(ctx, (int) AP_GetSlotDataInt(state, "link_tunic_color"));
+        _return(ctx, (int) slot_options.link_tunic_color);
     }
     
     DLLEXPORT void rando_get_shop_price(uint8_t* rdram, recomp_context* ctx)
@@ -739,160 +2922,38 @@ extern "C"
     DLLEXPORT void rando_get_location_type(uint8_t* rdram, recomp_context* ctx)
     {
         u32 arg = _arg<0, u32>(rdram, ctx);
-        int64_t location = 0x3469420000000 | fixLocation(arg);
-        _return(ctx, (int) AP_GetLocationItemType(state, location));
+        _return(ctx, getLocationInfo(arg).item_type);
     }
     
     DLLEXPORT void rando_get_item_id(uint8_t* rdram, recomp_context* ctx)
     {
         u32 arg = _arg<0, u32>(rdram, ctx);
         
+        syncReceivedItems();
+        
         if (arg == 0)
         {
             _return(ctx, 0);
             return;
         }
         
-        int64_t location = 0x3469420000000 | fixLocation(arg);
+        u32 index = getLocationIndex(arg);
         
-        if (AP_GetLocationHasLocalItem(state, location))
-        {
-            int64_t item = AP_GetItemAtLocation(state, location) & 0xFFFFFF;
-            
-            if ((item & 0xFF0000) == 0x000000)
-            {
-                u8 gi = item & 0xFF;
-                
-                if (gi == GI_SWORD_KOKIRI)
-                {
-                    _return(ctx, (u32) MIN(GI_SWORD_KOKIRI + hasItem(0x3469420000000 | GI_SWORD_KOKIRI), GI_SWORD_GILDED));
-                    return;
-                }
-                
-                else if (gi == GI_QUIVER_30)
-                {
-                    _return(ctx, (u32) MIN(GI_QUIVER_30 + hasItem(0x3469420000000 | GI_QUIVER_30), GI_QUIVER_50));
-                    return;
-                }
-                
-                else if (gi == GI_BOMB_BAG_20)
-                {
-                    _return(ctx, (u32) MIN(GI_BOMB_BAG_20 + hasItem(0x3469420000000 | GI_BOMB_BAG_20), GI_BOMB_BAG_40));
-                    return;
-                }
-                
-                else if (gi == GI_WALLET_ADULT)
-                {
-                    _return(ctx, (u32) MIN(GI_WALLET_ADULT + hasItem(0x3469420000000 | GI_WALLET_ADULT), GI_WALLET_GIANT));
-                    return;
-                }
-                
-                _return(ctx, (u32) gi);
-                return;
-            }
-            switch (item & 0xFF0000)
-            {
-                case 0x010000:
-                    switch (item & 0xFF)
-                    {
-                        case 0x7F:
-                            _return(ctx, (u32) GI_B2);
-                            return;
-                        case 0x00:
-                            _return(ctx, (u32) GI_46);
-                            return;
-                        case 0x01:
-                            _return(ctx, (u32) GI_47);
-                            return;
-                        case 0x02:
-                            _return(ctx, (u32) GI_48);
-                            return;
-                        case 0x03:
-                            _return(ctx, (u32) GI_49);
-                            return;
-                    }
-                    return;
-                case 0x020000:
-                    switch (item & 0xFF)
-                    {
-                        case 0x00:
-                            _return(ctx, (u32) GI_MAGIC_JAR_SMALL);
-                            return;
-                        case 0x01:
-                            _return(ctx, (u32) GI_71);
-                            return;
-                        case 0x03:
-                            _return(ctx, (u32) GI_73);
-                            return;
-                    }
-                    return;
-                case 0x040000:
-                    switch (item & 0xFF)
-                    {
-                        case ITEM_SONG_TIME:
-                            _return(ctx, (u32) GI_A6);
-                            return;
-                        case ITEM_SONG_HEALING:
-                            _return(ctx, (u32) GI_AF);
-                            return;
-                        case ITEM_SONG_EPONA:
-                            _return(ctx, (u32) GI_A5);
-                            return;
-                        case ITEM_SONG_SOARING:
-                            _return(ctx, (u32) GI_A3);
-                            return;
-                        case ITEM_SONG_STORMS:
-                            _return(ctx, (u32) GI_A2);
-                            return;
-                        case ITEM_SONG_SONATA:
-                            _return(ctx, (u32) GI_AE);
-                            return;
-                        case ITEM_SONG_LULLABY:
-                            _return(ctx, (u32) GI_AD);
-                            return;
-                        case ITEM_SONG_NOVA:
-                            _return(ctx, (u32) GI_AC);
-                            return;
-                        case ITEM_SONG_ELEGY:
-                            _return(ctx, (u32) GI_A8);
-                            return;
-                        case ITEM_SONG_OATH:
-                            _return(ctx, (u32) GI_A7);
-                            return;
-                    }
-                    return;
-                case 0x090000:
-                    switch (item & 0xFF)
-                    {
-                        case ITEM_KEY_BOSS:
-                            _return(ctx, (u32) (GI_MAX + (((item >> 8) & 0xF) * 4) + 1));
-                            return;
-                        case ITEM_KEY_SMALL:
-                            _return(ctx, (u32) (GI_MAX + (((item >> 8) & 0xF) * 4) + 2));
-                            return;
-                        case ITEM_DUNGEON_MAP:
-                            _return(ctx, (u32) (GI_MAX + (((item >> 8) & 0xF) * 4) + 3));
-                            return;
-                        case ITEM_COMPASS:
-                            _return(ctx, (u32) (GI_MAX + (((item >> 8) & 0xF) * 4) + 4));
-                            return;
-                    }
-                    return;
-            }
-        }
+        // Resolving the location first drops cached ids that predate the latest scout results.
+        bool info_valid = getLocationInfoAt(index).valid;
         
-        switch (AP_GetLocationItemType(state, location))
+        CachedItemId& cached = location_table.item_ids[index];
+        if (cached.valid && (!cached.progressive || cached.generation == received_items.generation))
         {
-            case ITEM_TYPE_FILLER:
-                _return(ctx, (u32) GI_AP_FILLER);
-                return;
-            case ITEM_TYPE_USEFUL:
-                _return(ctx, (u32) GI_AP_USEFUL);
-                return;
-            default:
-                _return(ctx, (u32) GI_AP_PROG);
-                return;
+            _return(ctx, cached.item_id);
+            return;
         }
+        
+        bool progressive = false;
+        u32 item_id = getItemId(arg, progressive);
+        cached = CachedItemId{ .item_id = item_id, .valid = info_valid, .progressive = progressive, .generation = received_items.generation };
+        
+        _return(ctx, item_id);
     }
     
     DLLEXPORT void rando_get_slotdata_u32(uint8_t* rdram, recomp_context* ctx)
@@ -918,6 +2979,105 @@ extern "C"
         setStr(rdram, ret_ptr, value);
     }
     
+    DLLEXPORT void rando_get_slotdata_string_bounded(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
+        PTR(char) ret_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        u32 ret_len = _arg<2, u32>(rdram, ctx);
+
+        std::string key = "";
+        getStr(rdram, ptr, key);
+        const char* value = AP_GetSlotDataString(state, key.c_str());
+
+        _return(ctx, setStrBounded(rdram, ret_ptr, ret_len, value));
+    }
+    
+    DLLEXPORT void rando_slotdata_key_handle(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
+
+        std::string key = "";
+        getStr(rdram, ptr, key);
+        
+        auto it = slotdata_key_handles.find(key);
+        if (it != slotdata_key_handles.end())
+        {
+            _return(ctx, it->second);
+            return;
+        }
+        
+        u32 handle = (u32) slotdata_keys.size();
+        slotdata_keys.push_back(SlotDataKey{ .key = key, .has_u32 = false, .u32_value = 0, .has_string = false, .string_value = "" });
+        slotdata_key_handles.emplace(std::move(key), handle);
+        
+        _return(ctx, handle);
+    }
+    
+    DLLEXPORT void rando_slotdata_u32_by_handle(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 handle = _arg<0, u32>(rdram, ctx);
+        
+        if (handle >= slotdata_keys.size())
+        {
+            _return<u32>(ctx, 0);
+            return;
+        }
+        
+        SlotDataKey& slotdata_key = slotdata_keys[handle];
+        if (!slotdata_key.has_u32)
+        {
+            slotdata_key.u32_value = (u32) (AP_GetSlotDataInt(state, slotdata_key.key.c_str()) & 0xFFFFFFFF);
+            slotdata_key.has_u32 = true;
+        }
+        
+        _return(ctx, slotdata_key.u32_value);
+    }
+    
+    DLLEXPORT void rando_slotdata_string_by_handle(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 handle = _arg<0, u32>(rdram, ctx);
+        PTR(char) ret_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        
+        if (handle >= slotdata_keys.size())
+        {
+            setStr(rdram, ret_ptr, "");
+            return;
+        }
+        
+        SlotDataKey& slotdata_key = slotdata_keys[handle];
+        if (!slotdata_key.has_string)
+        {
+            const char* value = AP_GetSlotDataString(state, slotdata_key.key.c_str());
+            slotdata_key.string_value = value != nullptr ? value : "";
+            slotdata_key.has_string = true;
+        }
+        
+        setStr(rdram, ret_ptr, slotdata_key.string_value.c_str());
+    }
+    
+    DLLEXPORT void rando_slotdata_string_by_handle_bounded(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 handle = _arg<0, u32>(rdram, ctx);
+        PTR(char) ret_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        u32 ret_len = _arg<2, u32>(rdram, ctx);
+        
+        if (handle >= slotdata_keys.size())
+        {
+            _return(ctx, setStrBounded(rdram, ret_ptr, ret_len, ""));
+            return;
+        }
+        
+        SlotDataKey& slotdata_key = slotdata_keys[handle];
+        if (!slotdata_key.has_string)
+        {
+            const char* value = AP_GetSlotDataString(state, slotdata_key.key.c_str());
+            slotdata_key.string_value = value != nullptr ? value : "";
+            slotdata_key.has_string = true;
+        }
+        
+        _return(ctx, setStrBounded(rdram, ret_ptr, ret_len, slotdata_key.string_value.data(), slotdata_key.string_value.size()));
+    }
+    
     DLLEXPORT void rando_get_slotdata_raw_o32(uint8_t* rdram, recomp_context* ctx)
     {
         PTR(char) key_ptr = _arg<0, PTR(char)>(rdram, ctx);
@@ -992,86 +3152,407 @@ extern "C"
         setStr(rdram, str_ptr, AP_AccessSlotDataRawString(state, jsonValue));
     }
     
-    DLLEXPORT void rando_get_datastorage_u32_sync(uint8_t* rdram, recomp_context* ctx)
+    DLLEXPORT void rando_access_slotdata_raw_string_o32_bounded(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(u32) in_ptr = _arg<0, u32>(rdram, ctx);
+        PTR(char) str_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        u32 str_len = _arg<2, u32>(rdram, ctx);
+        
+        u32 upper = MEM_W(in_ptr, 0);
+        u32 lower = MEM_W(in_ptr, 4);
+        
+        uintptr_t jsonValue = CRAFT_64(upper, lower);
+        
+        _return(ctx, setStrBounded(rdram, str_ptr, str_len, AP_AccessSlotDataRawString(state, jsonValue)));
+    }
+    
+    // Flattens a slot data array of ints into out_ptr, writing at most max_count elements.
+    // Returns the array's full element count so the caller can size its buffer.
+    DLLEXPORT void rando_access_slotdata_raw_u32_array_o32(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(u32) in_ptr = _arg<0, u32>(rdram, ctx);
+        PTR(u32) out_ptr = _arg<1, PTR(u32)>(rdram, ctx);
+        u32 max_count = _arg<2, u32>(rdram, ctx);
+        
+        u32 upper = MEM_W(in_ptr, 0);
+        u32 lower = MEM_W(in_ptr, 4);
+        
+        const Json::Value* jsonValue = reinterpret_cast<const Json::Value*>(CRAFT_64(upper, lower));
+        
+        if (jsonValue == nullptr || !jsonValue->isArray())
+        {
+            _return<u32>(ctx, 0);
+            return;
+        }
+        
+        u32 count = jsonValue->size();
+        RdramSpan<u32> out(rdram, out_ptr, MIN(count, max_count));
+        
+        for (u32 i = 0; i < out.count; ++i)
+        {
+            const Json::Value& element = (*jsonValue)[i];
+            out.write(i, getSlotDataU32(element));
+        }
+        
+        _return(ctx, count);
+    }
+    
+    // Flattens a slot data dict with integer keys and int values into out_ptr as SlotDataU32Pairs,
+    // writing at most max_count pairs in jsoncpp's key order. Members whose key isn't a base 10 u32 are skipped.
+    // Returns the number of members with valid keys.
+    DLLEXPORT void rando_access_slotdata_raw_u32_dict_o32(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(u32) in_ptr = _arg<0, u32>(rdram, ctx);
+        PTR(SlotDataU32Pair) out_ptr = _arg<1, PTR(SlotDataU32Pair)>(rdram, ctx);
+        u32 max_count = _arg<2, u32>(rdram, ctx);
+        
+        u32 upper = MEM_W(in_ptr, 0);
+        u32 lower = MEM_W(in_ptr, 4);
+        
+        const Json::Value* jsonValue = reinterpret_cast<const Json::Value*>(CRAFT_64(upper, lower));
+        
+        if (jsonValue == nullptr || !jsonValue->isObject())
+        {
+            _return<u32>(ctx, 0);
+            return;
+        }
+        
+        RdramSpan<SlotDataU32Pair> out(rdram, out_ptr, max_count);
+        u32 count = 0;
+        
+        for (auto it = jsonValue->begin(); it != jsonValue->end(); ++it)
+        {
+            u32 key;
+            if (!parseSlotDataU32Key(it.name(), key))
+            {
+                continue;
+            }
+            
+            if (count < out.count)
+            {
+                out.write(count, SlotDataU32Pair{
+                    .key = key,
+                    .value = getSlotDataU32(*it),
+                });
+            }
+            
+            count += 1;
+        }
+        
+        _return(ctx, count);
+    }
+    
+    DLLEXPORT void rando_slotdata_path_compile(uint8_t* rdram, recomp_context* ctx)
     {
         PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
-
-        std::string key = "";
-        getStr(rdram, ptr, key);
-        key += "_P" + std::to_string(AP_GetPlayerID(state));
-        char* value_char_ptr = AP_GetDataStorageSync(state, key.c_str());
-
+        
+        std::string path = "";
+        getStr(rdram, ptr, path);
+        
+        auto it = slotdata_path_handles.find(path);
+        if (it != slotdata_path_handles.end())
+        {
+            _return(ctx, it->second);
+            return;
+        }
+        
+        std::vector<SlotDataPathStep> steps;
+        if (!parseSlotDataPath(path, steps))
+        {
+            _return(ctx, SLOTDATA_INVALID_PATH);
+            return;
+        }
+        
+        u32 handle = (u32) slotdata_paths.size();
+        slotdata_paths.push_back(SlotDataPath{ .steps = std::move(steps), .node = SLOTDATA_NO_NODE, .session = 0 });
+        slotdata_path_handles.emplace(std::move(path), handle);
+        
+        if (slotdata_tree.built)
+        {
+            resolveSlotDataPath(slotdata_paths[handle]);
+        }
+        
+        _return(ctx, handle);
+    }
+    
+    DLLEXPORT void rando_slotdata_path_u32(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 handle = _arg<0, u32>(rdram, ctx);
+        
+        const SlotDataNode* node = getSlotDataPathNode(handle);
         u32 value = 0;
-
-        if (strncmp(value_char_ptr, "null", 4) != 0)
+        
+        if (node != nullptr && node->type == SLOTDATA_INT)
         {
-            value = std::stoi(value_char_ptr);
+            value = (u32) (node->value & 0xFFFFFFFF);
         }
-
+        
         _return(ctx, value);
     }
     
+    DLLEXPORT void rando_slotdata_path_string(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 handle = _arg<0, u32>(rdram, ctx);
+        PTR(char) ret_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        
+        const SlotDataNode* node = getSlotDataPathNode(handle);
+        
+        if (node != nullptr && node->type == SLOTDATA_STRING)
+        {
+            setStr(rdram, ret_ptr, slotdata_tree.strings.c_str() + node->first);
+        }
+        else
+        {
+            setStr(rdram, ret_ptr, "");
+        }
+    }
+    
+    DLLEXPORT void rando_slotdata_path_string_bounded(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 handle = _arg<0, u32>(rdram, ctx);
+        PTR(char) ret_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        u32 ret_len = _arg<2, u32>(rdram, ctx);
+        
+        const SlotDataNode* node = getSlotDataPathNode(handle);
+        const char* value = "";
+        
+        if (node != nullptr && node->type == SLOTDATA_STRING)
+        {
+            value = slotdata_tree.strings.c_str() + node->first;
+        }
+        
+        _return(ctx, setStrBounded(rdram, ret_ptr, ret_len, value));
+    }
+    
+    // Returns the element count of the array or dict a path resolves to, or 0 for anything else.
+    DLLEXPORT void rando_slotdata_path_count(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 handle = _arg<0, u32>(rdram, ctx);
+        
+        const SlotDataNode* node = getSlotDataPathNode(handle);
+        u32 count = 0;
+        
+        if (node != nullptr && (node->type == SLOTDATA_ARRAY || node->type == SLOTDATA_OBJECT))
+        {
+            count = node->count;
+        }
+        
+        _return(ctx, count);
+    }
+    
+    DLLEXPORT void rando_get_datastorage_u32_sync(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
+
+        std::string key = getDataStorageKey(rdram, ptr, true);
+        _return(ctx, getDataStorageU32Sync(key));
+    }
+    
     DLLEXPORT void rando_get_global_datastorage_u32_sync(uint8_t* rdram, recomp_context* ctx)
     {
         PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
 
-        std::string key = "";
-        getStr(rdram, ptr, key);
-        char* value_char_ptr = AP_GetDataStorageSync(state, key.c_str());
+        std::string key = getDataStorageKey(rdram, ptr, false);
+        _return(ctx, getDataStorageU32Sync(key));
+    }
+    
+    DLLEXPORT void rando_get_datastorage_string_sync(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
+        PTR(char) ret_ptr = _arg<1, PTR(char)>(rdram, ctx);
 
-        u32 value = 0;
+        std::string key = getDataStorageKey(rdram, ptr, true);
+        std::string value = getDataStorageStringSync(key);
+
+        setStr(rdram, ret_ptr, value.c_str());
+    }
+    
+    DLLEXPORT void rando_get_datastorage_string_sync_bounded(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
+        PTR(char) ret_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        u32 ret_len = _arg<2, u32>(rdram, ctx);
 
-        if (strncmp(value_char_ptr, "null", 4) != 0)
+        std::string key = getDataStorageKey(rdram, ptr, true);
+        std::string value = getDataStorageStringSync(key);
+
+        _return(ctx, setStrBounded(rdram, ret_ptr, ret_len, value.c_str(), value.size()));
+    }
+    
+    DLLEXPORT void rando_get_global_datastorage_string_sync(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
+        PTR(char) ret_ptr = _arg<1, PTR(char)>(rdram, ctx);
+
+        std::string key = getDataStorageKey(rdram, ptr, false);
+        std::string value = getDataStorageStringSync(key);
+
+        setStr(rdram, ret_ptr, value.c_str());
+    }
+    
+    DLLEXPORT void rando_get_global_datastorage_string_sync_bounded(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
+        PTR(char) ret_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        u32 ret_len = _arg<2, u32>(rdram, ctx);
+
+        std::string key = getDataStorageKey(rdram, ptr, false);
+        std::string value = getDataStorageStringSync(key);
+
+        _return(ctx, setStrBounded(rdram, ret_ptr, ret_len, value.c_str(), value.size()));
+    }
+    
+    // Reads count keys described by DataStorageKeyRequests at keys_ptr and writes a DataStorageValue for each to
+    // out_ptr. All the Gets are sent at once, so this waits for a single round trip, or until
+    // datastorage_multi_sync_timeout passes. Keys still missing then are reported as DATASTORAGE_VALUE_ERROR. Returns
+    // the number of values that are numbers.
+    DLLEXPORT void rando_get_datastorage_multi_sync(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(DataStorageKeyRequest) keys_ptr = _arg<0, PTR(DataStorageKeyRequest)>(rdram, ctx);
+        u32 count = _arg<1, u32>(rdram, ctx);
+        PTR(DataStorageValue) out_ptr = _arg<2, PTR(DataStorageValue)>(rdram, ctx);
+        
+        RdramSpan<DataStorageKeyRequest> keys(rdram, keys_ptr, count);
+        RdramSpan<DataStorageValue> out(rdram, out_ptr, count);
+        
+        pruneAbandonedDataStorageGets();
+        
+        std::vector<std::shared_ptr<DataStorageGet>> gets(count);
+        std::vector<std::string> mirrored(count);
+        
+        for (u32 i = 0; i < count; ++i)
         {
-            value = std::stoi(value_char_ptr);
+            DataStorageKeyRequest request = keys.read(i);
+            std::string key = getDataStorageKey(rdram, request.key, (request.flags & DATASTORAGE_KEY_FLAG_PER_PLAYER) != 0);
+            
+            flushDataStorageWrite(key);
+            
+            if (readDataStorageMirror(key, mirrored[i]))
+            {
+                continue;
+            }
+            
+            // Repeated keys, and keys something else is already fetching, share one Get.
+            gets[i] = fetchDataStorageKey(key);
         }
-
-        _return(ctx, value);
+        
+        auto pending = [&]()
+        {
+            return std::any_of(gets.begin(), gets.end(),
+                [](const auto& get) { return get != nullptr && loadRequestStatus(get->request.status) == AP_RequestStatus::Pending; });
+        };
+        
+        auto deadline = std::chrono::steady_clock::now() + datastorage_multi_sync_timeout;
+        while (pending() && AP_IsConnected(state) && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            updateDataStorageFetches();
+        }
+        
+        u32 numbers = 0;
+        
+        for (u32 i = 0; i < count; ++i)
+        {
+            DataStorageValue result{ .value = 0, .type = DATASTORAGE_VALUE_ERROR };
+            
+            if (gets[i] == nullptr)
+            {
+                result.type = classifyDataStorageValue(mirrored[i], result.value);
+            }
+            else if (loadRequestStatus(gets[i]->request.status) == AP_RequestStatus::Done)
+            {
+                result.type = classifyDataStorageValue(gets[i]->value, result.value);
+            }
+            else
+            {
+                abandonDataStorageGet(std::move(gets[i]));
+            }
+            
+            if (result.type == DATASTORAGE_VALUE_NUMBER)
+            {
+                numbers += 1;
+            }
+            
+            out.write(i, result);
+        }
+        
+        _return(ctx, numbers);
+    }
+    
+    // Mirrors a per-player key locally. The *_sync getters serve watched keys from the mirror once its first value
+    // has arrived.
+    DLLEXPORT void rando_datastorage_watch(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
+        watchDataStorageKey(getDataStorageKey(rdram, ptr, true));
+    }
+    
+    DLLEXPORT void rando_global_datastorage_watch(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
+        watchDataStorageKey(getDataStorageKey(rdram, ptr, false));
+    }
+    
+    // Starts a Get for a per-player key without waiting for the server. Returns a request ID for
+    // rando_datastorage_get_poll, or 0xFFFFFFFF if too many Gets are outstanding.
+    DLLEXPORT void rando_datastorage_get_begin(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
+        _return(ctx, beginDataStorageGet(getDataStorageKey(rdram, ptr, true)));
     }
     
-    DLLEXPORT void rando_get_datastorage_string_sync(uint8_t* rdram, recomp_context* ctx)
+    DLLEXPORT void rando_global_datastorage_get_begin(uint8_t* rdram, recomp_context* ctx)
     {
         PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
-        PTR(char) ret_ptr = _arg<1, PTR(char)>(rdram, ctx);
-
-        std::string key = "";
-        getStr(rdram, ptr, key);
-        key += "_P" + std::to_string(AP_GetPlayerID(state));
-        char* value = AP_GetDataStorageSync(state, key.c_str());
-
-        setStr(rdram, ret_ptr, value);
+        _return(ctx, beginDataStorageGet(getDataStorageKey(rdram, ptr, false)));
     }
     
-    DLLEXPORT void rando_get_global_datastorage_string_sync(uint8_t* rdram, recomp_context* ctx)
+    // Returns a DataStoragePollResult. Once the Get is done its value is written to out_ptr as a u32 (0 if it isn't a
+    // number) and the request ID is released.
+    DLLEXPORT void rando_datastorage_get_poll(uint8_t* rdram, recomp_context* ctx)
     {
-        PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
-        PTR(char) ret_ptr = _arg<1, PTR(char)>(rdram, ctx);
-
-        std::string key = "";
-        getStr(rdram, ptr, key);
-        char* value = AP_GetDataStorageSync(state, key.c_str());
-
-        setStr(rdram, ret_ptr, value);
+        u32 id = _arg<0, u32>(rdram, ctx);
+        PTR(u32) out_ptr = _arg<1, PTR(u32)>(rdram, ctx);
+        
+        std::string raw;
+        DataStoragePollResult result = pollDataStorageGet(id, raw);
+        
+        if (result == DATASTORAGE_DONE)
+        {
+            u32 value;
+            parseDataStorageU32(raw, value);
+            RdramPtr<u32>(rdram, out_ptr).write(value);
+        }
+        
+        _return(ctx, (u32) result);
+    }
+    
+    // Same as rando_datastorage_get_poll, but writes the value as a string truncated to out_len bytes.
+    DLLEXPORT void rando_datastorage_get_poll_string(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 id = _arg<0, u32>(rdram, ctx);
+        PTR(char) out_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        u32 out_len = _arg<2, u32>(rdram, ctx);
+        
+        std::string raw;
+        DataStoragePollResult result = pollDataStorageGet(id, raw);
+        
+        if (result == DATASTORAGE_DONE)
+        {
+            std::string value = parseDataStorageString(raw);
+            setStrBounded(rdram, out_ptr, out_len, value.c_str(), value.size());
+        }
+        
+        _return(ctx, (u32) result);
     }
     
     DLLEXPORT void rando_set_datastorage_u32_sync(uint8_t* rdram, recomp_context* ctx)
     {
         PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
         u32 value = _arg<1, u32>(rdram, ctx);
-        std::string key = "";
-        getStr(rdram, ptr, key);
-        key += "_P" + std::to_string(AP_GetPlayerID(state));
-
-        try
-        {
-            AP_SetDataStorageSync(state, key.c_str(), (char*) std::to_string(value).c_str());
-        }
+        std::string key = getDataStorageKey(rdram, ptr, true);
 
-        catch (std::exception e)
-        {
-            fprintf(stderr, "error setting datastorage u32\n");
-            fprintf(stderr, e.what());
-        }
+        setDataStorageSync(key, std::to_string(value).c_str());
     }
     
     DLLEXPORT void rando_set_global_datastorage_u32_sync(uint8_t* rdram, recomp_context* ctx)
@@ -1081,36 +3562,16 @@ extern "C"
         std::string key = "";
         getStr(rdram, ptr, key);
 
-        try
-        {
-            AP_SetDataStorageSync(state, key.c_str(), (char*) std::to_string(value).c_str());
-        }
-
-        catch (std::exception e)
-        {
-            fprintf(stderr, "error setting datastorage u32\n");
-            fprintf(stderr, e.what());
-        }
+        setDataStorageSync(key, std::to_string(value).c_str());
     }
     
     DLLEXPORT void rando_set_datastorage_u32_async(uint8_t* rdram, recomp_context* ctx)
     {
         PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
         u32 value = _arg<1, u32>(rdram, ctx);
-        std::string key = "";
-        getStr(rdram, ptr, key);
-        key += "_P" + std::to_string(AP_GetPlayerID(state));
-
-        try
-        {
-            AP_SetDataStorageAsync(state, key.c_str(), (char*) std::to_string(value).c_str());
-        }
+        std::string key = getDataStorageKey(rdram, ptr, true);
 
-        catch (std::exception e)
-        {
-            fprintf(stderr, "error setting datastorage u32\n");
-            fprintf(stderr, e.what());
-        }
+        bufferDataStorageU32(key, value);
     }
     
     DLLEXPORT void rando_set_global_datastorage_u32_async(uint8_t* rdram, recomp_context* ctx)
@@ -1120,16 +3581,7 @@ extern "C"
         std::string key = "";
         getStr(rdram, ptr, key);
 
-        try
-        {
-            AP_SetDataStorageAsync(state, key.c_str(), (char*) std::to_string(value).c_str());
-        }
-
-        catch (std::exception e)
-        {
-            fprintf(stderr, "error setting datastorage u32\n");
-            fprintf(stderr, e.what());
-        }
+        bufferDataStorageU32(key, value);
     }
     
     DLLEXPORT void rando_set_datastorage_string_sync(uint8_t* rdram, recomp_context* ctx)
@@ -1137,24 +3589,12 @@ extern "C"
         PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
         PTR(char) value_ptr = _arg<1, PTR(char)>(rdram, ctx);
         
-        std::string key = "";
-        getStr(rdram, ptr, key);
+        std::string key = getDataStorageKey(rdram, ptr, true);
         
         std::string value = "";
         getStr(rdram, value_ptr, value);
-        
-        key += "_P" + std::to_string(AP_GetPlayerID(state));
 
-        try
-        {
-            AP_SetDataStorageSync(state, key.c_str(), (char*) value.c_str());
-        }
-
-        catch (std::exception e)
-        {
-            fprintf(stderr, "error setting datastorage u32\n");
-            fprintf(stderr, e.what());
-        }
+        setDataStorageSync(key, value.c_str());
     }
     
     DLLEXPORT void rando_set_global_datastorage_string_sync(uint8_t* rdram, recomp_context* ctx)
@@ -1168,16 +3608,7 @@ extern "C"
         std::string value = "";
         getStr(rdram, value_ptr, value);
 
-        try
-        {
-            AP_SetDataStorageSync(state, key.c_str(), (char*) value.c_str());
-        }
-
-        catch (std::exception e)
-        {
-            fprintf(stderr, "error setting datastorage u32\n");
-            fprintf(stderr, e.what());
-        }
+        setDataStorageSync(key, value.c_str());
     }
     
     DLLEXPORT void rando_set_datastorage_string_async(uint8_t* rdram, recomp_context* ctx)
@@ -1185,24 +3616,12 @@ extern "C"
         PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
         PTR(char) value_ptr = _arg<1, PTR(char)>(rdram, ctx);
         
-        std::string key = "";
-        getStr(rdram, ptr, key);
+        std::string key = getDataStorageKey(rdram, ptr, true);
         
         std::string value = "";
         getStr(rdram, value_ptr, value);
-        
-        key += "_P" + std::to_string(AP_GetPlayerID(state));
-
-        try
-        {
-            AP_SetDataStorageAsync(state, key.c_str(), (char*) value.c_str());
-        }
 
-        catch (std::exception e)
-        {
-            fprintf(stderr, "error setting datastorage u32\n");
-            fprintf(stderr, e.what());
-        }
+        bufferDataStorageString(key, std::move(value));
     }
     
     DLLEXPORT void rando_set_global_datastorage_string_async(uint8_t* rdram, recomp_context* ctx)
@@ -1216,16 +3635,161 @@ extern "C"
         std::string value = "";
         getStr(rdram, value_ptr, value);
 
-        try
+        bufferDataStorageString(key, std::move(value));
+    }
+    
+    // Registers a per-player datastorage key and returns a handle for the *_by_handle exports, which use the
+    // prebuilt key instead of reading and suffixing it on every call. Global keys are registered with
+    // rando_global_datastorage_key_handle, so each handle export covers both of its key-based counterparts.
+    DLLEXPORT void rando_datastorage_key_handle(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
+        _return(ctx, registerDataStorageKey(getDataStorageKey(rdram, ptr, false), true));
+    }
+    
+    DLLEXPORT void rando_global_datastorage_key_handle(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
+        _return(ctx, registerDataStorageKey(getDataStorageKey(rdram, ptr, false), false));
+    }
+    
+    DLLEXPORT void rando_get_datastorage_u32_sync_by_handle(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 handle = _arg<0, u32>(rdram, ctx);
+        const std::string* key = getDataStorageKeyByHandle(handle);
+        
+        _return<u32>(ctx, key != nullptr ? getDataStorageU32Sync(*key) : 0);
+    }
+    
+    DLLEXPORT void rando_get_datastorage_string_sync_by_handle(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 handle = _arg<0, u32>(rdram, ctx);
+        PTR(char) ret_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        const std::string* key = getDataStorageKeyByHandle(handle);
+        
+        if (key == nullptr)
         {
-            AP_SetDataStorageAsync(state, key.c_str(), (char*) value.c_str());
+            setStr(rdram, ret_ptr, "");
+            return;
         }
-
-        catch (std::exception e)
+        
+        std::string value = getDataStorageStringSync(*key);
+        setStr(rdram, ret_ptr, value.c_str());
+    }
+    
+    DLLEXPORT void rando_get_datastorage_string_sync_by_handle_bounded(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 handle = _arg<0, u32>(rdram, ctx);
+        PTR(char) ret_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        u32 ret_len = _arg<2, u32>(rdram, ctx);
+        const std::string* key = getDataStorageKeyByHandle(handle);
+        
+        if (key == nullptr)
+        {
+            _return(ctx, setStrBounded(rdram, ret_ptr, ret_len, ""));
+            return;
+        }
+        
+        std::string value = getDataStorageStringSync(*key);
+        _return(ctx, setStrBounded(rdram, ret_ptr, ret_len, value.c_str(), value.size()));
+    }
+    
+    DLLEXPORT void rando_set_datastorage_u32_sync_by_handle(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 handle = _arg<0, u32>(rdram, ctx);
+        u32 value = _arg<1, u32>(rdram, ctx);
+        const std::string* key = getDataStorageKeyByHandle(handle);
+        
+        if (key != nullptr)
+        {
+            setDataStorageSync(*key, std::to_string(value).c_str());
+        }
+    }
+    
+    DLLEXPORT void rando_set_datastorage_u32_async_by_handle(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 handle = _arg<0, u32>(rdram, ctx);
+        u32 value = _arg<1, u32>(rdram, ctx);
+        const std::string* key = getDataStorageKeyByHandle(handle);
+        
+        if (key != nullptr)
+        {
+            bufferDataStorageU32(*key, value);
+        }
+    }
+    
+    DLLEXPORT void rando_set_datastorage_string_sync_by_handle(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 handle = _arg<0, u32>(rdram, ctx);
+        PTR(char) value_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        const std::string* key = getDataStorageKeyByHandle(handle);
+        
+        if (key != nullptr)
+        {
+            std::string value = "";
+            getStr(rdram, value_ptr, value);
+            setDataStorageSync(*key, value.c_str());
+        }
+    }
+    
+    DLLEXPORT void rando_set_datastorage_string_async_by_handle(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 handle = _arg<0, u32>(rdram, ctx);
+        PTR(char) value_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        const std::string* key = getDataStorageKeyByHandle(handle);
+        
+        if (key != nullptr)
+        {
+            std::string value = "";
+            getStr(rdram, value_ptr, value);
+            bufferDataStorageString(*key, std::move(value));
+        }
+    }
+    
+    // Applies a DataStorageOp to a per-player key with a signed operand, so add can also subtract. Pass want_reply to
+    // get a request ID that rando_datastorage_get_poll completes with the key's new value; returns 0xFFFFFFFF otherwise.
+    DLLEXPORT void rando_datastorage_op(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
+        u32 op = _arg<1, u32>(rdram, ctx);
+        s32 operand = _arg<2, s32>(rdram, ctx);
+        u32 want_reply = _arg<3, u32>(rdram, ctx);
+        
+        if (op >= DATASTORAGE_OP_COUNT)
+        {
+            _return(ctx, DATASTORAGE_INVALID_REQUEST);
+            return;
+        }
+        
+        _return(ctx, applyDataStorageOp(getDataStorageKey(rdram, ptr, true), (DataStorageOp) op, operand, want_reply != 0));
+    }
+    
+    DLLEXPORT void rando_global_datastorage_op(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) ptr = _arg<0, PTR(char)>(rdram, ctx);
+        u32 op = _arg<1, u32>(rdram, ctx);
+        s32 operand = _arg<2, s32>(rdram, ctx);
+        u32 want_reply = _arg<3, u32>(rdram, ctx);
+        
+        if (op >= DATASTORAGE_OP_COUNT)
         {
-            fprintf(stderr, "error setting datastorage u32\n");
-            fprintf(stderr, e.what());
+            _return(ctx, DATASTORAGE_INVALID_REQUEST);
+            return;
         }
+        
+        _return(ctx, applyDataStorageOp(getDataStorageKey(rdram, ptr, false), (DataStorageOp) op, operand, want_reply != 0));
+    }
+    
+    DLLEXPORT void rando_flush_datastorage(uint8_t* rdram, recomp_context* ctx)
+    {
+        flushDataStorageWrites();
+    }
+    
+    // Sets how often buffered *_async datastorage writes are flushed. 0 flushes on every update.
+    DLLEXPORT void rando_set_datastorage_flush_interval(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 interval_ms = _arg<0, u32>(rdram, ctx);
+        datastorage_writes.flush_interval = std::chrono::milliseconds(interval_ms);
     }
     
     DLLEXPORT void rando_get_own_slot_id(uint8_t* rdram, recomp_context* ctx)
@@ -1239,14 +3803,28 @@ extern "C"
         setStr(rdram, str_ptr, AP_GetPlayerName(state));
     }
     
+    DLLEXPORT void rando_get_own_slot_name_bounded(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(char) str_ptr = _arg<0, PTR(char)>(rdram, ctx);
+        u32 str_len = _arg<1, u32>(rdram, ctx);
+        _return(ctx, setStrBounded(rdram, str_ptr, str_len, AP_GetPlayerName(state)));
+    }
+    
     DLLEXPORT void rando_get_location_item_player(uint8_t* rdram, recomp_context* ctx)
     {
         u32 location_id_arg = _arg<0, u32>(rdram, ctx);
         PTR(char) str_ptr = _arg<1, PTR(char)>(rdram, ctx);
         
-        int64_t location_id = ((int64_t) (((int64_t) 0x3469420000000) | ((int64_t) fixLocation(location_id_arg))));
+        setStr(rdram, str_ptr, getLocationName(getLocationInfo(location_id_arg).item_player_offset));
+    }
+    
+    DLLEXPORT void rando_get_location_item_player_bounded(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 location_id_arg = _arg<0, u32>(rdram, ctx);
+        PTR(char) str_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        u32 str_len = _arg<2, u32>(rdram, ctx);
         
-        setStr(rdram, str_ptr, AP_GetLocationItemPlayer(state, location_id));
+        _return(ctx, setStrBounded(rdram, str_ptr, str_len, getLocationName(getLocationInfo(location_id_arg).item_player_offset)));
     }
     
     DLLEXPORT void rando_get_location_item_name(uint8_t* rdram, recomp_context* ctx)
@@ -1254,13 +3832,23 @@ extern "C"
         u32 location_id_arg = _arg<0, u32>(rdram, ctx);
         PTR(char) str_ptr = _arg<1, PTR(char)>(rdram, ctx);
         
-        int64_t location_id = ((int64_t) (((int64_t) 0x3469420000000) | ((int64_t) fixLocation(location_id_arg))));
+        setStr(rdram, str_ptr, getLocationName(getLocationInfo(location_id_arg).item_name_offset));
+    }
+    
+    DLLEXPORT void rando_get_location_item_name_bounded(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 location_id_arg = _arg<0, u32>(rdram, ctx);
+        PTR(char) str_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        u32 str_len = _arg<2, u32>(rdram, ctx);
         
-        setStr(rdram, str_ptr, AP_GetLocationItemName(state, location_id));
+        _return(ctx, setStrBounded(rdram, str_ptr, str_len, getLocationName(getLocationInfo(location_id_arg).item_name_offset)));
     }
     
     DLLEXPORT void rando_get_items_size(uint8_t* rdram, recomp_context* ctx)
     {
+        // Polled by the item receive loop, so it also drives flushing when rando_connection_update isn't used.
+        updateLocationChecks();
+        updateDataStorageWrites();
         _return(ctx, ((u32) AP_GetReceivedItemsSize(state)));
     }
     
@@ -1282,6 +3870,48 @@ extern "C"
         _return(ctx, ((u32) AP_GetSendingPlayer(state, items_i) & 0xFFFFFFFF));
     }
     
+    // Copies up to max_count received items starting at index cursor into out_ptr as ReceivedItemRecords.
+    // Returns the number of records written.
+    DLLEXPORT void rando_get_items_since(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 cursor = _arg<0, u32>(rdram, ctx);
+        PTR(ReceivedItemRecord) out_ptr = _arg<1, PTR(ReceivedItemRecord)>(rdram, ctx);
+        u32 max_count = _arg<2, u32>(rdram, ctx);
+        
+        syncReceivedItems();
+        
+        size_t items_size = received_items.ids.size();
+        if (cursor >= items_size)
+        {
+            _return<u32>(ctx, 0);
+            return;
+        }
+        
+        u32 count = (u32) MIN(items_size - cursor, (size_t) max_count);
+        int64_t own_slot = AP_GetPlayerID(state);
+        RdramSpan<ReceivedItemRecord> out(rdram, out_ptr, count);
+        
+        for (u32 i = 0; i < count; ++i)
+        {
+            size_t item_i = cursor + i;
+            u32 flags = 0;
+            
+            if (received_items.senders[item_i] == own_slot)
+            {
+                flags |= RECEIVED_ITEM_FLAG_OWN_SLOT;
+            }
+            
+            out.write(i, ReceivedItemRecord{
+                .item = (u32) received_items.ids[item_i],
+                .location = (s32) received_items.locations[item_i],
+                .sending_player = (u32) (received_items.senders[item_i] & 0xFFFFFFFF),
+                .flags = flags,
+            });
+        }
+        
+        _return(ctx, count);
+    }
+    
     DLLEXPORT void rando_get_item_name_from_id(uint8_t* rdram, recomp_context* ctx)
     {
         u32 arg = _arg<0, u32>(rdram, ctx);
@@ -1292,6 +3922,17 @@ extern "C"
         setStr(rdram, str_ptr, AP_GetItemNameFromID(state, item_id));
     }
     
+    DLLEXPORT void rando_get_item_name_from_id_bounded(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 arg = _arg<0, u32>(rdram, ctx);
+        PTR(char) str_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        u32 str_len = _arg<2, u32>(rdram, ctx);
+        
+        int64_t item_id = ((int64_t) (((int64_t) 0x3469420000000) | ((int64_t) arg)));
+        
+        _return(ctx, setStrBounded(rdram, str_ptr, str_len, AP_GetItemNameFromID(state, item_id)));
+    }
+    
     DLLEXPORT void rando_get_sending_player_name(uint8_t* rdram, recomp_context* ctx)
     {
         u32 items_i = _arg<0, u32>(rdram, ctx);
@@ -1302,6 +3943,17 @@ extern "C"
         setStr(rdram, str_ptr, AP_GetPlayerFromSlot(state, sending_player));
     }
     
+    DLLEXPORT void rando_get_sending_player_name_bounded(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 items_i = _arg<0, u32>(rdram, ctx);
+        PTR(char) str_ptr = _arg<1, PTR(char)>(rdram, ctx);
+        u32 str_len = _arg<2, u32>(rdram, ctx);
+        
+        int64_t sending_player = AP_GetSendingPlayer(state, items_i);
+        
+        _return(ctx, setStrBounded(rdram, str_ptr, str_len, AP_GetPlayerFromSlot(state, sending_player)));
+    }
+    
     DLLEXPORT void rando_has_item(uint8_t* rdram, recomp_context* ctx)
     {
         u32 arg = _arg<0, u32>(rdram, ctx);
@@ -1316,10 +3968,29 @@ extern "C"
         _return(ctx, hasItem(item_id));
     }
     
+    DLLEXPORT void rando_has_items_bulk(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(u32) ids_ptr = _arg<0, PTR(u32)>(rdram, ctx);
+        u32 count = _arg<1, u32>(rdram, ctx);
+        PTR(u32) out_ptr = _arg<2, PTR(u32)>(rdram, ctx);
+        
+        RdramSpan<u32> ids(rdram, ids_ptr, count);
+        RdramSpan<u32> out(rdram, out_ptr, count);
+        
+        syncReceivedItems();
+        
+        for (u32 i = 0; i < count; ++i)
+        {
+            int64_t item_id = ((int64_t) (((int64_t) 0x3469420000000) | ((int64_t) (ids.read(i) & 0xFFFFFF))));
+            auto it = received_items.counts.find(item_id);
+            out.write(i, it != received_items.counts.end() ? it->second : 0);
+        }
+    }
+    
     DLLEXPORT void rando_broadcast_location_hint(uint8_t* rdram, recomp_context* ctx)
     {
         u32 arg = _arg<0, u32>(rdram, ctx);
-        int64_t location_id = ((int64_t) (((int64_t) 0x3469420000000) | ((int64_t) fixLocation(arg))));
+        int64_t location_id = getLocationInfo(arg).location_id;
         AP_QueueLocationScout(state, location_id);
         AP_SendQueuedLocationScouts(state, 2);
     }
@@ -1327,29 +3998,129 @@ extern "C"
     DLLEXPORT void rando_send_location(uint8_t* rdram, recomp_context* ctx)
     {
         u32 arg = _arg<0, u32>(rdram, ctx);
-        int64_t location_id = ((int64_t) (((int64_t) 0x3469420000000) | ((int64_t) fixLocation(arg))));
-        if (AP_LocationExists(state, location_id))
+        u32 index = getLocationIndex(arg);
+        const LocationInfo& info = getLocationInfoAt(index);
+        int64_t location_id = info.location_id;
+        if (info.exists)
         {
             last_location_sent = location_id;
-            if (!AP_GetLocationIsChecked(state, location_id))
+            if (!isLocationChecked(location_id))
             {
-                AP_SendItem(state, location_id);
+                queueLocationCheck(location_id);
             }
         }
     }
     
+    DLLEXPORT void rando_flush_locations(uint8_t* rdram, recomp_context* ctx)
+    {
+        flushLocationChecks();
+    }
+    
+    // Sets how often rando_connection_update flushes queued location checks. 0 flushes on every update.
+    DLLEXPORT void rando_set_location_flush_interval(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 interval_ms = _arg<0, u32>(rdram, ctx);
+        location_checks.flush_interval = std::chrono::milliseconds(interval_ms);
+    }
+    
     DLLEXPORT void rando_location_is_checked(uint8_t* rdram, recomp_context* ctx)
     {
         u32 arg = _arg<0, u32>(rdram, ctx);
-        int64_t location_id = ((int64_t) (((int64_t) 0x3469420000000) | ((int64_t) fixLocation(arg))));
-        _return(ctx, AP_GetLocationIsChecked(state, location_id));
+        _return(ctx, isLocationChecked(getLocationInfo(arg).location_id));
     }
     
     DLLEXPORT void rando_location_is_checked_async(uint8_t* rdram, recomp_context* ctx)
     {
         u32 arg = _arg<0, u32>(rdram, ctx);
-        int64_t location_id = ((int64_t) (((int64_t) 0x3469420000000) | ((int64_t) fixLocation(arg))));
-        _return(ctx, AP_GetLocationIsChecked(state, location_id));
+        _return(ctx, isLocationChecked(getLocationInfo(arg).location_id));
+    }
+    
+    // Returns a location's bit in the checked bitmap, or 0xFFFFFFFF if it isn't in the bitmap. Bits follow the sorted
+    // scout list, so they're the same every time a seed is connected to.
+    DLLEXPORT void rando_get_location_index(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 arg = _arg<0, u32>(rdram, ctx);
+        
+        syncCheckedBitmap();
+        
+        auto it = checked_bitmap.indices.find(getLocationInfo(arg).location_id);
+        _return(ctx, it != checked_bitmap.indices.end() ? it->second : CHECKED_BITMAP_NO_INDEX);
+    }
+    
+    // Returns the location argument for a bit in the checked bitmap, or 0xFFFFFFFF if the bit is out of range.
+    DLLEXPORT void rando_get_checked_bitmap_location(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 index = _arg<0, u32>(rdram, ctx);
+        
+        syncCheckedBitmap();
+        
+        if (index >= checked_bitmap.locations.size())
+        {
+            _return(ctx, CHECKED_BITMAP_NO_INDEX);
+            return;
+        }
+        
+        _return(ctx, (u32) (checked_bitmap.locations[index] & 0xFFFFFF));
+    }
+    
+    // Returns the number of bits in the checked bitmap. It's 0 until the scout results have arrived.
+    DLLEXPORT void rando_get_checked_bitmap_size(uint8_t* rdram, recomp_context* ctx)
+    {
+        syncCheckedBitmap();
+        _return(ctx, (u32) checked_bitmap.locations.size());
+    }
+    
+    // Copies up to len words of the checked bitmap to out_ptr, with bit (i % 32) of word (i / 32) set if the location
+    // at index i is checked. Returns the bitmap version the copy corresponds to.
+    DLLEXPORT void rando_get_checked_bitmap(uint8_t* rdram, recomp_context* ctx)
+    {
+        PTR(u32) out_ptr = _arg<0, PTR(u32)>(rdram, ctx);
+        u32 len = _arg<1, u32>(rdram, ctx);
+        
+        syncCheckedBitmap();
+        
+        RdramSpan<u32> out(rdram, out_ptr, len);
+        for (u32 i = 0; i < len; ++i)
+        {
+            out.write(i, i < checked_bitmap.words.size() ? checked_bitmap.words[i] : 0);
+        }
+        
+        _return(ctx, checked_bitmap.version);
+    }
+    
+    DLLEXPORT void rando_get_checked_bitmap_version(uint8_t* rdram, recomp_context* ctx)
+    {
+        syncCheckedBitmap();
+        _return(ctx, checked_bitmap.version);
+    }
+    
+    // Writes a CheckedBitmapDelta to out_ptr for each bitmap word from start_word on that changed after since_version,
+    // up to max_count. Returns the number of entries written; if that's max_count, call again with start_word set
+    // past the last word_index written. Rebuilding the bitmap marks every word as changed.
+    DLLEXPORT void rando_get_checked_bitmap_delta(uint8_t* rdram, recomp_context* ctx)
+    {
+        u32 since_version = _arg<0, u32>(rdram, ctx);
+        u32 start_word = _arg<1, u32>(rdram, ctx);
+        PTR(CheckedBitmapDelta) out_ptr = _arg<2, PTR(CheckedBitmapDelta)>(rdram, ctx);
+        u32 max_count = _arg<3, u32>(rdram, ctx);
+        
+        syncCheckedBitmap();
+        
+        RdramSpan<CheckedBitmapDelta> out(rdram, out_ptr, max_count);
+        u32 count = 0;
+        
+        for (u32 i = start_word; i < checked_bitmap.words.size() && count < max_count; ++i)
+        {
+            if (checked_bitmap.word_versions[i] > since_version)
+            {
+                out.write(count++, CheckedBitmapDelta{
+                    .word_index = i,
+                    .bits = checked_bitmap.words[i],
+                });
+            }
+        }
+        
+        _return(ctx, count);
     }
     
     DLLEXPORT void rando_get_last_location_sent(uint8_t* rdram, recomp_context* ctx)
@@ -1359,6 +4130,7 @@ extern "C"
     
     DLLEXPORT void rando_complete_goal(uint8_t* rdram, recomp_context* ctx)
     {
+        flushLocationChecks();
         AP_StoryComplete(state);
     }
 }
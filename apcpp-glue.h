@@ -2,6 +2,8 @@
 
 #include <stdint.h>
 #include <string>
+#include <cstring>
+#include <type_traits>
 #include <iostream>
 #include <filesystem>
 
@@ -568,6 +570,133 @@ typedef uint64_t gpr;
     *(uint32_t*)(rdram + ((((reg) + (offset) + 0)) - 0xFFFFFFFF80000000)) = (uint32_t)((gpr)(val) >> 32); \
 }
 
+// Byteswap-aware kernels for moving strings between host memory and rdram a word at a time.
+size_t rdram_strlen(uint8_t* rdram, gpr str);
+void rdram_read_bytes(uint8_t* rdram, gpr src, char* dst, size_t len);
+void rdram_write_bytes(uint8_t* rdram, gpr dst, const char* src, size_t len);
+
+// Typed views over rdram that apply the N64 byteswap rules for T at compile time. 32-bit values are stored natively,
+// 64-bit values are stored as two 32-bit words with the upper half first, and 8/16-bit values have their address
+// swizzled within the containing word. Structs must be made only of 32-bit fields so they can be copied in one
+// memcpy; build records that need narrower or wider fields out of u32 words, then opt them in by specializing
+// rdram_word_layout_struct right after the definition.
+template <typename T>
+constexpr bool rdram_word_layout_struct = false;
+
+template <typename T>
+constexpr bool rdram_is_word_layout = rdram_word_layout_struct<T> ||
+    ((std::is_integral_v<T> || std::is_floating_point_v<T> || std::is_enum_v<T>) && sizeof(T) == 4);
+
+template <typename T>
+constexpr bool rdram_is_supported = rdram_is_word_layout<T> ||
+    ((std::is_integral_v<T> || std::is_floating_point_v<T> || std::is_enum_v<T>) && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 8));
+
+template <typename T>
+struct RdramPtr {
+    static_assert(rdram_is_supported<T>, "Type has no rdram layout");
+    static_assert(!rdram_word_layout_struct<T> || (std::is_trivially_copyable_v<T> && sizeof(T) % 4 == 0 && alignof(T) == 4),
+        "Word layout structs must be made only of 32-bit fields");
+
+    uint8_t* rdram;
+    gpr addr;
+
+    RdramPtr(uint8_t* rdram, PTR(T) ptr) : rdram(rdram), addr((gpr) ptr) {}
+    RdramPtr(uint8_t* rdram, gpr addr) : rdram(rdram), addr(addr) {}
+
+    T read() const {
+        T ret;
+        if constexpr (sizeof(T) == 1) {
+            uint8_t val = MEM_BU(0, addr);
+            std::memcpy(&ret, &val, sizeof(T));
+        }
+        else if constexpr (sizeof(T) == 2) {
+            uint16_t val = MEM_HU(0, addr);
+            std::memcpy(&ret, &val, sizeof(T));
+        }
+        else if constexpr (sizeof(T) == 8 && !std::is_class_v<T>) {
+            uint64_t val = ((uint64_t) (uint32_t) MEM_W(0, addr) << 32) | (uint32_t) MEM_W(4, addr);
+            std::memcpy(&ret, &val, sizeof(T));
+        }
+        else {
+            std::memcpy(&ret, host(), sizeof(T));
+        }
+        return ret;
+    }
+
+    void write(const T& val) const {
+        if constexpr (sizeof(T) == 1) {
+            std::memcpy(&MEM_BU(0, addr), &val, sizeof(T));
+        }
+        else if constexpr (sizeof(T) == 2) {
+            std::memcpy(&MEM_HU(0, addr), &val, sizeof(T));
+        }
+        else if constexpr (sizeof(T) == 8 && !std::is_class_v<T>) {
+            uint64_t raw;
+            std::memcpy(&raw, &val, sizeof(T));
+            MEM_W(0, addr) = (int32_t) (raw >> 32);
+            MEM_W(4, addr) = (int32_t) raw;
+        }
+        else {
+            std::memcpy(host(), &val, sizeof(T));
+        }
+    }
+
+    RdramPtr<T> operator+(size_t count) const {
+        return RdramPtr<T>(rdram, addr + count * sizeof(T));
+    }
+
+    // Host address of the value. Only meaningful for word layout types.
+    void* host() const {
+        return rdram + (addr - 0xFFFFFFFF80000000);
+    }
+};
+
+template <typename T>
+struct RdramSpan {
+    RdramPtr<T> begin;
+    size_t count;
+
+    RdramSpan(uint8_t* rdram, PTR(T) ptr, size_t count) : begin(rdram, ptr), count(count) {}
+
+    T read(size_t index) const {
+        return (begin + index).read();
+    }
+
+    void write(size_t index, const T& val) const {
+        (begin + index).write(val);
+    }
+
+    // Copies count elements out of rdram.
+    void read_all(T* out) const {
+        if constexpr (rdram_is_word_layout<T>) {
+            std::memcpy(out, begin.host(), count * sizeof(T));
+        }
+        else if constexpr (sizeof(T) == 1) {
+            rdram_read_bytes(begin.rdram, begin.addr, reinterpret_cast<char*>(out), count);
+        }
+        else {
+            for (size_t i = 0; i < count; i++) {
+                out[i] = read(i);
+            }
+        }
+    }
+
+    // Copies count elements into rdram.
+    void write_all(const T* in) const {
+        if constexpr (rdram_is_word_layout<T>) {
+            std::memcpy(begin.host(), in, count * sizeof(T));
+        }
+        else if constexpr (sizeof(T) == 1) {
+            rdram_write_bytes(begin.rdram, begin.addr, reinterpret_cast<const char*>(in), count);
+        }
+        else {
+            for (size_t i = 0; i < count; i++) {
+                write(i, in[i]);
+            }
+        }
+    }
+};
+
 #define GI_TRUE_SKULL_TOKEN GI_75
 
 #define GI_AP_PROG GI_77
@@ -583,15 +712,33 @@ typedef uint64_t gpr;
 #define RECOMP_ARG_U8STR(_pos) _arg_u8string<_pos>(rdram, ctx)
 #define RECOMP_RETURN(_type, _value) _return(ctx, (_type) _value); return
 
+// Raw 32-bit word for an o32 argument slot. The first four slots are passed in a0-a3 and the rest are on the stack
+// after the 16 bytes of home space the caller reserves for a0-a3.
+template<int index>
+gpr _arg_word(uint8_t* rdram, recomp_context* ctx) {
+    static_assert(index >= 0, "Negative arg index");
+    if constexpr (index < 4) {
+        return (&ctx->r4)[index];
+    }
+    else {
+        return (gpr) MEM_W(0x10 + (index - 4) * 4, ctx->r29);
+    }
+}
+
 template<int index, typename T>
 T _arg(uint8_t* rdram, recomp_context* ctx) {
-    static_assert(index < 4, "Only args 0 through 3 supported");
-    gpr raw_arg = (&ctx->r4)[index];
+    gpr raw_arg = _arg_word<index>(rdram, ctx);
     if constexpr (std::is_same_v<T, float>) {
         if constexpr (index < 2) {
             static_assert(index != 1, "Floats in arg 1 not supported");
             return ctx->f12.fl;
         }
+        else if constexpr (index >= 4) {
+            uint32_t bits = (uint32_t) raw_arg;
+            float ret;
+            std::memcpy(&ret, &bits, sizeof(ret));
+            return ret;
+        }
         else {
             // static_assert in else workaround
             [] <bool flag = false>() {
@@ -603,8 +750,15 @@ T _arg(uint8_t* rdram, recomp_context* ctx) {
         static_assert (!std::is_pointer_v<std::remove_pointer_t<T>>, "Double pointers not supported");
         return TO_PTR(std::remove_pointer_t<T>, raw_arg);
     }
+    else if constexpr (std::is_integral_v<T> && sizeof(T) == 8) {
+        // o32 passes 64-bit values in an aligned pair of slots with the upper half first.
+        static_assert(index % 2 == 0, "64-bit args must start on an even arg slot");
+        uint64_t upper = (uint32_t) raw_arg;
+        uint64_t lower = (uint32_t) _arg_word<index + 1>(rdram, ctx);
+        return static_cast<T>((upper << 32) | lower);
+    }
     else if constexpr (std::is_integral_v<T>) {
-        static_assert(sizeof(T) <= 4, "64-bit args not supported");
+        static_assert(sizeof(T) <= 4, "Unsupported integer size");
         return static_cast<T>(raw_arg);
     }
     else {
@@ -620,17 +774,11 @@ std::string _arg_string(uint8_t* rdram, recomp_context* ctx) {
     PTR(char) str = _arg<arg_index, PTR(char)>(rdram, ctx);
 
     // Get the length of the byteswapped string.
-    size_t len = 0;
-    while (MEM_B(str, len) != 0x00) {
-        len++;
-    }
+    size_t len = rdram_strlen(rdram, (gpr) str);
 
     std::string ret{};
-    ret.reserve(len + 1);
-
-    for (size_t i = 0; i < len; i++) {
-        ret += (char)MEM_B(str, i);
-    }
+    ret.resize(len);
+    rdram_read_bytes(rdram, (gpr) str, ret.data(), len);
 
     return ret;
 }
@@ -640,18 +788,11 @@ std::u8string _arg_u8string(uint8_t* rdram, recomp_context* ctx) {
     PTR(char) str = _arg<arg_index, PTR(char)>(rdram, ctx);
 
     // Get the length of the byteswapped string.
-    size_t len = 0;
-    while (MEM_B(str, len) != 0x00) {
-        std::cout << MEM_B(str, len);
-        len++;
-    }
+    size_t len = rdram_strlen(rdram, (gpr) str);
 
     std::u8string ret{};
-    ret.reserve(len + 1);
-
-    for (size_t i = 0; i < len; i++) {
-        ret += (char)MEM_B(str, i);
-    }
+    ret.resize(len);
+    rdram_read_bytes(rdram, (gpr) str, reinterpret_cast<char*>(ret.data()), len);
 
     return ret;
 }
@@ -659,13 +800,18 @@ std::u8string _arg_u8string(uint8_t* rdram, recomp_context* ctx) {
 
 template <typename T>
 void _return(recomp_context* ctx, T val) {
-    static_assert(sizeof(T) <= 4, "Only 32-bit value returns supported currently");
+    static_assert(sizeof(T) <= 8, "Only 32-bit and 64-bit value returns supported currently");
     if constexpr (std::is_same_v<T, float>) {
         ctx->f0.fl = val;
     }
     else if constexpr (std::is_integral_v<T> && sizeof(T) <= 4) {
         ctx->r2 = int32_t(val);
     }
+    else if constexpr (std::is_integral_v<T> && sizeof(T) == 8) {
+        // o32 returns 64-bit values in v0/v1 with the upper half in v0.
+        ctx->r2 = int32_t(uint64_t(val) >> 32);
+        ctx->r3 = int32_t(uint64_t(val));
+    }
     else {
         // static_assert in else workaround
         [] <bool flag = false>() {
@@ -0,0 +1,119 @@
+// Microbenchmark for the rdram string kernels in apcpp-rdram-string.cpp. Built once per kernel variant when
+// APCPP_GLUE_BUILD_BENCHMARKS is on, and compared against the byte-at-a-time loops the kernels replaced.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "apcpp-glue.h"
+
+#ifndef RDRAM_STRING_BENCH_VARIANT
+#define RDRAM_STRING_BENCH_VARIANT "default"
+#endif
+
+size_t rdram_strlen(uint8_t* rdram, gpr str);
+void rdram_read_bytes(uint8_t* rdram, gpr src, char* dst, size_t len);
+void rdram_write_bytes(uint8_t* rdram, gpr dst, const char* src, size_t len);
+
+constexpr size_t rdram_size = 8 * 1024 * 1024;
+constexpr gpr rdram_base = 0xFFFFFFFF80000000;
+
+static size_t reference_strlen(uint8_t* rdram, gpr str) {
+    size_t len = 0;
+    while (MEM_B(len, str) != 0x00) {
+        len++;
+    }
+    return len;
+}
+
+static void reference_read_bytes(uint8_t* rdram, gpr src, char* dst, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = (char)MEM_B(i, src);
+    }
+}
+
+static void reference_write_bytes(uint8_t* rdram, gpr dst, const char* src, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        MEM_B(i, dst) = src[i];
+    }
+}
+
+// Keeps the optimizer from dropping the calls being timed.
+static volatile size_t sink;
+
+template <typename F>
+static double time_ns(size_t iterations, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        f();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    // The kernels rely on rdram being page aligned.
+    uint8_t* rdram = static_cast<uint8_t*>(::operator new(rdram_size, std::align_val_t{ 4096 }));
+    for (size_t i = 0; i < rdram_size; i++) {
+        rdram[i] = (uint8_t)(0x20 + i % 0x5F);
+    }
+
+    const size_t lengths[] = { 3, 15, 31, 64, 255, 1024, 4096 };
+    const gpr offsets[] = { 0, 1, 3 };
+    int mismatches = 0;
+
+    printf("rdram string kernels: %s\n", RDRAM_STRING_BENCH_VARIANT);
+    printf("%-6s %-4s %-6s %12s %12s %8s\n", "op", "off", "len", "ref ns", "kernel ns", "speedup");
+
+    for (gpr offset : offsets) {
+        for (size_t len : lengths) {
+            gpr str = rdram_base + 0x1000 + offset;
+            std::vector<char> host(len + 1);
+            std::vector<char> check(len + 1);
+            for (size_t i = 0; i < len; i++) {
+                host[i] = (char)('a' + i % 26);
+            }
+
+            // write
+            reference_write_bytes(rdram, str, host.data(), len + 1);
+            rdram_write_bytes(rdram, str + 0x10000, host.data(), len + 1);
+            reference_read_bytes(rdram, str + 0x10000, check.data(), len + 1);
+            if (check != host) {
+                fprintf(stderr, "write mismatch at offset %u length %zu\n", (unsigned)offset, len);
+                mismatches++;
+            }
+            double write_ref = time_ns(iterations, [&]() { reference_write_bytes(rdram, str, host.data(), len); });
+            double write_kernel = time_ns(iterations, [&]() { rdram_write_bytes(rdram, str, host.data(), len); });
+            printf("%-6s %-4u %-6zu %12.1f %12.1f %7.2fx\n", "write", (unsigned)offset, len, write_ref, write_kernel, write_ref / write_kernel);
+
+            // strlen
+            if (rdram_strlen(rdram, str) != reference_strlen(rdram, str)) {
+                fprintf(stderr, "strlen mismatch at offset %u length %zu\n", (unsigned)offset, len);
+                mismatches++;
+            }
+            double strlen_ref = time_ns(iterations, [&]() { sink = reference_strlen(rdram, str); });
+            double strlen_kernel = time_ns(iterations, [&]() { sink = rdram_strlen(rdram, str); });
+            printf("%-6s %-4u %-6zu %12.1f %12.1f %7.2fx\n", "strlen", (unsigned)offset, len, strlen_ref, strlen_kernel, strlen_ref / strlen_kernel);
+
+            // read
+            rdram_read_bytes(rdram, str, check.data(), len + 1);
+            if (check != host) {
+                fprintf(stderr, "read mismatch at offset %u length %zu\n", (unsigned)offset, len);
+                mismatches++;
+            }
+            double read_ref = time_ns(iterations, [&]() { reference_read_bytes(rdram, str, check.data(), len); sink = check[0]; });
+            double read_kernel = time_ns(iterations, [&]() { rdram_read_bytes(rdram, str, check.data(), len); sink = check[0]; });
+            printf("%-6s %-4u %-6zu %12.1f %12.1f %7.2fx\n", "read", (unsigned)offset, len, read_ref, read_kernel, read_ref / read_kernel);
+        }
+    }
+
+    ::operator delete(rdram, std::align_val_t{ 4096 });
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
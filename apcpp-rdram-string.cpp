@@ -0,0 +1,200 @@
+#include <cstring>
+
+// The widest vector kernels the target supports. Defining RDRAM_STRING_SCALAR forces the plain word-at-a-time
+// versions, which the benchmark uses to compare against.
+#if !defined(RDRAM_STRING_SCALAR) && defined(__AVX2__)
+#define RDRAM_STRING_AVX2
+#elif !defined(RDRAM_STRING_SCALAR) && (defined(__SSE2__) || defined(_M_X64))
+#define RDRAM_STRING_SSE2
+#endif
+
+#if defined(RDRAM_STRING_AVX2)
+#include <immintrin.h>
+#elif defined(RDRAM_STRING_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "apcpp-glue.h"
+
+// rdram is stored as native-endian 32-bit words, so byte N of a word lives at host offset (N ^ 3).
+// These kernels move whole words at a time and byteswap them instead of swizzling every byte's address.
+
+static inline uint32_t bswap32(uint32_t val) {
+#if defined(_MSC_VER)
+    return _byteswap_ulong(val);
+#else
+    return __builtin_bswap32(val);
+#endif
+}
+
+static inline uint32_t ctz32(uint32_t val) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, val);
+    return index;
+#else
+    return __builtin_ctz(val);
+#endif
+}
+
+// Host pointer to the start of the rdram word containing an aligned N64 address.
+static inline uint8_t* rdram_word_ptr(uint8_t* rdram, gpr addr) {
+    return rdram + (addr - 0xFFFFFFFF80000000);
+}
+
+#if defined(RDRAM_STRING_AVX2)
+static inline __m256i bswap32_vec(__m256i val) {
+    const __m256i mask = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    return _mm256_shuffle_epi8(val, mask);
+}
+#elif defined(RDRAM_STRING_SSE2)
+static inline __m128i bswap32_vec(__m128i val) {
+    // Swap the bytes in each 16-bit lane, then swap the 16-bit lanes in each 32-bit lane.
+    val = _mm_or_si128(_mm_slli_epi16(val, 8), _mm_srli_epi16(val, 8));
+    val = _mm_shufflelo_epi16(val, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_shufflehi_epi16(val, _MM_SHUFFLE(2, 3, 0, 1));
+}
+#endif
+
+// Position of the first zero byte in an rdram word, or 4 if there is none. The word's value is in N64 byte order,
+// so the string's first byte is the most significant one.
+static inline size_t word_zero_index(uint32_t word) {
+    // Sets the high bit of every zero byte.
+    uint32_t zeroes = (word - 0x01010101u) & ~word & 0x80808080u;
+    if (zeroes == 0) {
+        return 4;
+    }
+    for (size_t i = 0; i < 4; i++) {
+        if (((word >> (24 - i * 8)) & 0xFF) == 0) {
+            return i;
+        }
+    }
+    return 4;
+}
+
+size_t rdram_strlen(uint8_t* rdram, gpr str) {
+    size_t len = 0;
+
+    // Walk byte by byte up to a word boundary.
+    while (((str + len) & 3) != 0) {
+        if (MEM_B(len, str) == 0x00) {
+            return len;
+        }
+        len++;
+    }
+
+    // Then a word at a time up to a full vector boundary, which is also where short strings end.
+#if defined(RDRAM_STRING_AVX2)
+    constexpr gpr align = 32;
+#elif defined(RDRAM_STRING_SSE2)
+    constexpr gpr align = 16;
+#else
+    constexpr gpr align = 4;
+#endif
+
+    do {
+        uint32_t word = *reinterpret_cast<const uint32_t*>(rdram_word_ptr(rdram, str + len));
+        size_t zero_index = word_zero_index(word);
+        if (zero_index != 4) {
+            return len + zero_index;
+        }
+        len += 4;
+    } while (((str + len) & (align - 1)) != 0);
+
+    // rdram itself is page aligned, so aligned loads never cross into another page and reading past the
+    // terminator here is safe.
+    while (true) {
+#if defined(RDRAM_STRING_AVX2)
+        __m256i block = bswap32_vec(_mm256_load_si256(reinterpret_cast<const __m256i*>(rdram_word_ptr(rdram, str + len))));
+        uint32_t zeroes = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_setzero_si256()));
+        if (zeroes != 0) {
+            return len + ctz32(zeroes);
+        }
+        len += 32;
+#elif defined(RDRAM_STRING_SSE2)
+        __m128i block = bswap32_vec(_mm_load_si128(reinterpret_cast<const __m128i*>(rdram_word_ptr(rdram, str + len))));
+        uint32_t zeroes = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_setzero_si128()));
+        if (zeroes != 0) {
+            return len + ctz32(zeroes);
+        }
+        len += 16;
+#else
+        uint32_t word = *reinterpret_cast<const uint32_t*>(rdram_word_ptr(rdram, str + len));
+        size_t zero_index = word_zero_index(word);
+        if (zero_index != 4) {
+            return len + zero_index;
+        }
+        len += 4;
+#endif
+    }
+}
+
+void rdram_read_bytes(uint8_t* rdram, gpr src, char* dst, size_t len) {
+    size_t i = 0;
+
+    while (i < len && ((src + i) & 3) != 0) {
+        dst[i] = (char)MEM_B(i, src);
+        i++;
+    }
+
+#if defined(RDRAM_STRING_AVX2)
+    for (; len - i >= 32; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rdram_word_ptr(rdram, src + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), bswap32_vec(block));
+    }
+#elif defined(RDRAM_STRING_SSE2)
+    for (; len - i >= 16; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rdram_word_ptr(rdram, src + i)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), bswap32_vec(block));
+    }
+#endif
+
+    for (; len - i >= 4; i += 4) {
+        uint32_t word;
+        std::memcpy(&word, rdram_word_ptr(rdram, src + i), sizeof(word));
+        word = bswap32(word);
+        std::memcpy(dst + i, &word, sizeof(word));
+    }
+
+    for (; i < len; i++) {
+        dst[i] = (char)MEM_B(i, src);
+    }
+}
+
+void rdram_write_bytes(uint8_t* rdram, gpr dst, const char* src, size_t len) {
+    size_t i = 0;
+
+    while (i < len && ((dst + i) & 3) != 0) {
+        MEM_B(i, dst) = src[i];
+        i++;
+    }
+
+#if defined(RDRAM_STRING_AVX2)
+    for (; len - i >= 32; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(rdram_word_ptr(rdram, dst + i)), bswap32_vec(block));
+    }
+#elif defined(RDRAM_STRING_SSE2)
+    for (; len - i >= 16; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rdram_word_ptr(rdram, dst + i)), bswap32_vec(block));
+    }
+#endif
+
+    for (; len - i >= 4; i += 4) {
+        uint32_t word;
+        std::memcpy(&word, src + i, sizeof(word));
+        word = bswap32(word);
+        std::memcpy(rdram_word_ptr(rdram, dst + i), &word, sizeof(word));
+    }
+
+    for (; i < len; i++) {
+        MEM_B(i, dst) = src[i];
+    }
+}
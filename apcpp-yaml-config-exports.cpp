@@ -20,10 +20,7 @@ std::string _arg_string_length(uint8_t* rdram, recomp_context* ctx, u32 len) {
 
     std::string ret{};
     ret.resize(len);
-
-    for (size_t i = 0; i < len; i++) {
-        ret[i] = (char)MEM_B(str, i);
-    }
+    rdram_read_bytes(rdram, (gpr) str, ret.data(), len);
 
     return ret;
 }